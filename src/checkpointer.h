@@ -0,0 +1,298 @@
+// Background checkpoints of a trainer's regret and strategy-sum tables, shared by the Kuhn and Dudo trainers.
+// A checkpoint holds the iteration, node count and actions per node, then per node its key, regret sums and strategy
+// sums.
+
+#ifndef SRC_CHECKPOINTER_H_
+#define SRC_CHECKPOINTER_H_
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The trainer fills one of two snapshot buffers while a background thread writes the other.
+template <typename Key>
+class Checkpointer {
+   public:
+    struct Snapshot {
+        int iteration = 0;
+        std::vector<Key> keys;
+        std::vector<double> values;
+    };
+
+   private:
+    std::string filename;
+    int num_actions;
+    int every_iterations;
+    double every_seconds;
+    int last_iteration;
+    std::chrono::steady_clock::time_point last_time;
+
+    std::array<Snapshot, 2> buffers;
+    int filling = -1, ready = -1, writing = -1;
+    bool stopping = false;
+    std::mutex lock;
+    std::condition_variable changed;
+    std::thread writer;
+
+    // The checkpoint being assembled. A node is copied before its first update after the checkpoint began, and the
+    // rest are swept a few per iteration.
+    Snapshot* snapshot = nullptr;
+    int snapshot_epoch = 0, snapshot_size = 0, sweep_position = 0;
+    static constexpr int SWEEP_NODES_PER_ITERATION = 256;
+
+    static void append(std::string& bytes, const void* data, size_t size) {
+        bytes.append(static_cast<const char*>(data), size);
+    }
+
+    static void append_key(std::string& bytes, int key) { append(bytes, &key, sizeof(key)); }
+
+    static void append_key(std::string& bytes, const std::string& key) {
+        uint32_t length = key.size();
+        append(bytes, &length, sizeof(length));
+        append(bytes, key.data(), length);
+    }
+
+    static void read_key(std::ifstream& infile, uint64_t, int& key) {
+        infile.read(reinterpret_cast<char*>(&key), sizeof(key));
+    }
+
+    static void read_key(std::ifstream& infile, uint64_t file_size, std::string& key) {
+        uint32_t length = 0;
+        infile.read(reinterpret_cast<char*>(&length), sizeof(length));
+        if (!infile) return;
+
+        if (length > file_size - (uint64_t)infile.tellg()) {
+            infile.setstate(std::ios::failbit);
+            return;
+        }
+
+        key.resize(length);
+        infile.read(&key[0], length);
+    }
+
+    // Writes to a temporary file and renames it over the previous checkpoint, so a crash keeps the last complete one.
+    void write(const Snapshot& snapshot, std::string& bytes) {
+        bytes.clear();
+        uint64_t header[3] = {(uint64_t)snapshot.iteration, snapshot.keys.size(), (uint64_t)num_actions};
+        append(bytes, header, sizeof(header));
+        for (size_t k = 0; k < snapshot.keys.size(); k++) {
+            append_key(bytes, snapshot.keys[k]);
+            append(bytes, &snapshot.values[k * 2 * num_actions], 2 * num_actions * sizeof(double));
+        }
+
+        std::string temporary = filename + ".tmp";
+        int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            std::cerr << "Error: Could not open file " << temporary << " for writing." << std::endl;
+            return;
+        }
+
+        bool ok = true;
+        for (size_t written = 0; ok && written < bytes.size();) {
+            ssize_t result = ::write(fd, bytes.data() + written, bytes.size() - written);
+            ok = result > 0;
+            if (ok) written += result;
+        }
+        ok = ok && fsync(fd) == 0;
+        close(fd);
+
+        if (!ok || rename(temporary.c_str(), filename.c_str()) != 0) {
+            std::cerr << "Error: Could not write checkpoint " << filename << "." << std::endl;
+            return;
+        }
+
+        size_t slash = filename.find_last_of('/');
+        std::string directory = slash == std::string::npos ? "." : filename.substr(0, slash + 1);
+        int directory_fd = open(directory.c_str(), O_RDONLY);
+        if (directory_fd >= 0) {
+            fsync(directory_fd);
+            close(directory_fd);
+        }
+    }
+
+    void run() {
+        std::string bytes;
+        std::unique_lock<std::mutex> guard(lock);
+
+        while (true) {
+            changed.wait(guard, [&] { return ready >= 0 || stopping; });
+            if (ready < 0) return;
+
+            writing = ready;
+            ready = -1;
+            guard.unlock();
+            write(buffers[writing], bytes);
+            guard.lock();
+            writing = -1;
+            changed.notify_all();
+        }
+    }
+
+    // Returns a buffer sized for num_nodes nodes, or nullptr while the previous checkpoint is still queued.
+    Snapshot* begin_snapshot(int iteration, int num_nodes) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (ready >= 0) return nullptr;
+
+        filling = writing == 0 ? 1 : 0;
+        last_iteration = iteration;
+        last_time = std::chrono::steady_clock::now();
+
+        Snapshot& buffer = buffers[filling];
+        buffer.iteration = iteration;
+        buffer.keys.resize(num_nodes);
+        buffer.values.resize(num_nodes * 2 * num_actions);
+        return &buffer;
+    }
+
+    void end_snapshot() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            ready = filling;
+            filling = -1;
+        }
+        changed.notify_all();
+    }
+
+   public:
+    // Zero disables either trigger.
+    Checkpointer(const std::string& filename, int num_actions, int every_iterations, double every_seconds,
+                 int iteration)
+        : filename(filename),
+          num_actions(num_actions),
+          every_iterations(every_iterations),
+          every_seconds(every_seconds),
+          last_iteration(iteration),
+          last_time(std::chrono::steady_clock::now()),
+          writer(&Checkpointer::run, this) {}
+
+    ~Checkpointer() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        changed.notify_all();
+        writer.join();
+    }
+
+    bool is_due(int iteration) const {
+        if (every_iterations > 0 && iteration - last_iteration >= every_iterations) return true;
+        if (every_seconds <= 0) return false;
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - last_time;
+        return elapsed.count() >= every_seconds;
+    }
+
+    // Blocks until every queued checkpoint is on disk.
+    void flush() {
+        std::unique_lock<std::mutex> guard(lock);
+        changed.wait(guard, [&] { return ready < 0 && writing < 0; });
+    }
+
+    // Copies the node into the checkpoint being assembled, unless it is already there or was created after it began.
+    template <typename Node>
+    void preserve(Node* node, Key Node::*key) {
+        if (snapshot == nullptr || node->index >= snapshot_size || node->checkpoint_epoch == snapshot_epoch) return;
+
+        node->checkpoint_epoch = snapshot_epoch;
+        snapshot->keys[node->index] = node->*key;
+
+        double* values = &snapshot->values[node->index * 2 * num_actions];
+        std::copy(node->regret_sum.begin(), node->regret_sum.end(), values);
+        std::copy(node->strategy_sum.begin(), node->strategy_sum.end(), values + num_actions);
+    }
+
+    // Begins a checkpoint when one is due, then sweeps the next few nodes into it.
+    template <typename Node>
+    void advance(int iteration, const std::vector<Node*>& nodes, Key Node::*key, bool finish = false) {
+        if (snapshot == nullptr) {
+            if (!finish && !is_due(iteration)) return;
+
+            snapshot = begin_snapshot(iteration, nodes.size());
+            if (snapshot == nullptr) return;
+
+            snapshot_epoch++;
+            snapshot_size = nodes.size();
+            sweep_position = 0;
+        }
+
+        int sweep_end = finish ? snapshot_size : std::min(snapshot_size, sweep_position + SWEEP_NODES_PER_ITERATION);
+        for (; sweep_position < sweep_end; sweep_position++) preserve(nodes[sweep_position], key);
+
+        if (sweep_position == snapshot_size) {
+            end_snapshot();
+            snapshot = nullptr;
+        }
+    }
+
+    // Takes the final checkpoint once any checkpoint still being assembled or written has finished.
+    template <typename Node>
+    void take_final(int iteration, const std::vector<Node*>& nodes, Key Node::*key) {
+        if (snapshot != nullptr) advance(iteration, nodes, key, true);
+        flush();
+        advance(iteration, nodes, key, true);
+        flush();
+    }
+
+    static bool read(const std::string& filename, int num_actions, Snapshot& snapshot) {
+        std::ifstream infile(filename, std::ios::binary | std::ios::ate);
+
+        if (!infile.is_open()) {
+            std::cerr << "Error: Could not open file " << filename << " for reading." << std::endl;
+            return false;
+        }
+
+        uint64_t file_size = infile.tellg();
+        infile.seekg(0);
+
+        uint64_t header[3];
+        infile.read(reinterpret_cast<char*>(header), sizeof(header));
+        if (!infile) {
+            std::cerr << "Error: Checkpoint " << filename << " is truncated." << std::endl;
+            return false;
+        }
+
+        if (header[2] != (uint64_t)num_actions) {
+            std::cerr << "Error: Checkpoint " << filename << " has " << header[2] << " actions per node, expected "
+                      << num_actions << "." << std::endl;
+            return false;
+        }
+
+        // Every node takes at least a four-byte key or key length and its sums.
+        uint64_t min_node_bytes = 4 + 2 * num_actions * sizeof(double);
+        if (header[1] > (file_size - sizeof(header)) / min_node_bytes) {
+            std::cerr << "Error: Checkpoint " << filename << " is truncated." << std::endl;
+            return false;
+        }
+
+        snapshot.iteration = header[0];
+        snapshot.keys.resize(header[1]);
+        snapshot.values.resize(header[1] * 2 * num_actions);
+
+        for (size_t k = 0; infile && k < snapshot.keys.size(); k++) {
+            read_key(infile, file_size, snapshot.keys[k]);
+            char* values = reinterpret_cast<char*>(&snapshot.values[k * 2 * num_actions]);
+            infile.read(values, 2 * num_actions * sizeof(double));
+        }
+
+        if (!infile) {
+            std::cerr << "Error: Checkpoint " << filename << " is truncated." << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+};
+
+#endif  // SRC_CHECKPOINTER_H_
@@ -0,0 +1,175 @@
+// Differential equivalence and performance-regression check for the Dudo trainers. Each engine of section-3-5-1.h
+// must reproduce the reference trainer of section-3-5-2.h within the tolerance, and keep at least min_fraction of its
+// recorded baseline speedup over it.
+// Usage: dudo-equivalence [iterations] [tolerance] [min_fraction]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "section-3-5-1.h"
+#include "section-3-5-2.h"
+
+using namespace std;
+
+struct Result {
+    double value;
+    vector<int> keys;
+    vector<vector<double>> strategies;
+};
+
+// baseline_speedup is the lowest speedup over the reference recorded on any gated game.
+struct Engine {
+    string name;
+    double baseline_speedup;
+    function<Result()> train;
+    function<double()> time_run;
+};
+
+template <typename Trainer>
+Engine make_engine(const string& name, double baseline_speedup, const function<Trainer()>& make,
+                   const function<double(Trainer&)>& train) {
+    Engine engine;
+    engine.name = name;
+    engine.baseline_speedup = baseline_speedup;
+
+    engine.train = [=] {
+        Trainer trainer = make();
+        Result result;
+        result.value = train(trainer);
+        result.keys = trainer.get_infoset_keys();
+        for (int key : result.keys) result.strategies.push_back(trainer.get_average_strategy(key));
+        return result;
+    };
+
+    engine.time_run = [=] {
+        Trainer trainer = make();
+        auto start = chrono::steady_clock::now();
+        train(trainer);
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    };
+
+    return engine;
+}
+
+// Median training time of each engine, with runs going round-robin so drift in machine load affects all alike.
+vector<double> median_seconds(const vector<Engine>& engines) {
+    const int MIN_TIMED_RUNS = 5;
+    const double MIN_TIMED_SECONDS = 0.5;
+
+    vector<vector<double>> seconds(engines.size());
+    vector<double> totals(engines.size(), 0.0);
+
+    for (int r = 0; r < MIN_TIMED_RUNS || *min_element(totals.begin(), totals.end()) < MIN_TIMED_SECONDS; r++) {
+        for (size_t e = 0; e < engines.size(); e++) {
+            seconds[e].push_back(engines[e].time_run());
+            totals[e] += seconds[e].back();
+        }
+    }
+
+    vector<double> medians;
+    for (vector<double>& runs : seconds) {
+        nth_element(runs.begin(), runs.begin() + runs.size() / 2, runs.end());
+        medians.push_back(runs[runs.size() / 2]);
+    }
+
+    return medians;
+}
+
+// Largest difference between two results, or infinity if they reached different infosets.
+double divergence(const Result& reference, const Result& candidate) {
+    if (reference.keys != candidate.keys) return numeric_limits<double>::infinity();
+
+    double largest = fabs(reference.value - candidate.value);
+    for (size_t k = 0; k < reference.keys.size(); k++) {
+        for (size_t a = 0; a < reference.strategies[k].size(); a++) {
+            largest = max(largest, fabs(reference.strategies[k][a] - candidate.strategies[k][a]));
+        }
+    }
+
+    return largest;
+}
+
+int main(int argc, char* argv[]) {
+    int iterations = argc > 1 ? stoi(argv[1]) : 1'000;
+    double tolerance = argc > 2 ? stod(argv[2]) : 1e-9;
+    double min_fraction = argc > 3 ? stod(argv[3]) : 0.75;
+
+    // Smaller games train too quickly to time reliably, so their speedup is reported but not gated.
+    const size_t MIN_GATED_INFOSETS = 1'000;
+
+    // Batches of more than one iteration interleave updates and change the results by design, so they are not listed.
+    const vector<tuple<string, int, double>> specifications = {{"bitset", 0, 1.1}, {"bitset batched", 1, 2.8}};
+    const vector<pair<int, int>> configurations = {{2, 1}, {3, 1}, {4, 1}, {5, 1}, {6, 1}, {2, 2}, {3, 2}};
+
+    cout << setw(6) << "Sides" << setw(6) << "Dice" << setw(13) << "Mode" << setw(16) << "Engine" << setw(12)
+         << "Infosets" << setw(13) << "Divergence" << setw(10) << "Speedup" << endl;
+
+    int failures = 0;
+    for (auto [num_sides, dice_per_player] : configurations) {
+        if (!history_dudo::DudoTrainer::check_game(num_sides, dice_per_player) ||
+            !bitset_dudo::DudoTrainer::check_game(num_sides, dice_per_player)) {
+            failures++;
+            continue;
+        }
+
+        for (bool alternating : {false, true}) {
+            vector<Engine> engines = {make_engine<history_dudo::DudoTrainer>(
+                "reference", 1.0, [=] { return history_dudo::DudoTrainer(num_sides, dice_per_player); },
+                [=](history_dudo::DudoTrainer& trainer) { return trainer.train(iterations, alternating); })};
+
+            for (const auto& [name, batch_size, baseline_speedup] : specifications) {
+                engines.push_back(make_engine<bitset_dudo::DudoTrainer>(
+                    name, baseline_speedup, [=] { return bitset_dudo::DudoTrainer(num_sides, dice_per_player); },
+                    [=, batch_size = batch_size](bitset_dudo::DudoTrainer& trainer) {
+                        return trainer.train(iterations, alternating, batch_size);
+                    }));
+            }
+
+            Result reference = engines[0].train();
+            vector<double> seconds = median_seconds(engines);
+            bool gated = reference.keys.size() >= MIN_GATED_INFOSETS;
+
+            for (size_t e = 1; e < engines.size(); e++) {
+                Result candidate = engines[e].train();
+                double difference = divergence(reference, candidate);
+                double speedup = seconds[0] / seconds[e];
+
+                cout << setw(6) << num_sides << setw(6) << dice_per_player << setw(13)
+                     << (alternating ? "alternating" : "simultaneous") << setw(16) << engines[e].name << setw(12)
+                     << candidate.keys.size() << setw(13) << scientific << setprecision(2) << difference << setw(10)
+                     << fixed << setprecision(2) << speedup;
+
+                if (difference > tolerance) {
+                    cout << "  DIVERGED";
+                    failures++;
+                }
+                if (!gated) {
+                    cout << "  (not gated)";
+                } else if (speedup < min_fraction * engines[e].baseline_speedup) {
+                    cout << "  REGRESSED";
+                    failures++;
+                }
+                cout << endl;
+            }
+        }
+    }
+
+    if (failures > 0) {
+        cerr << "Error: " << failures << " check(s) failed against the reference." << endl;
+        return 1;
+    }
+
+    cout << "All engines match the reference within " << scientific << setprecision(1) << tolerance
+         << " and reach at least " << fixed << setprecision(2) << min_fraction
+         << " of their baseline speedups on every gated game." << endl;
+    return 0;
+}
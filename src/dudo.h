@@ -0,0 +1,159 @@
+// Rules of the last round of Dudo shared by the trainers of section-3-5-1.h and section-3-5-2.h and by evaluation.cpp.
+
+#ifndef SRC_DUDO_H_
+#define SRC_DUDO_H_
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "philox.h"
+
+// Actions are the claims, ordered by count and then by rank with wild ones ranking highest, followed by dudo.
+class DudoGame {
+   public:
+    // A pair of sorted rolls and its probability.
+    struct Deal {
+        std::vector<int> dice;
+        std::array<int, 2> roll_codes;
+        double probability;
+    };
+
+    int num_sides, dice_per_player, num_actions, dudo;
+    std::vector<int> claim_num, claim_rank;
+
+    // Also checks that a table with a slot for every possible infoset key stays within max_table_slots.
+    static bool check_game(int num_sides, int dice_per_player, uint64_t max_table_slots = UINT64_MAX) {
+        if (num_sides < 2 || dice_per_player < 1) {
+            std::cerr << "Error: A game needs at least 2 sides and 1 die per player." << std::endl;
+            return false;
+        }
+
+        long long claim_bits = 2LL * dice_per_player * num_sides;
+        uint64_t num_slots = 0;
+        if (claim_bits < 31) {
+            uint64_t num_roll_codes = 1;
+            for (int d = 0; d < dice_per_player; d++) num_roll_codes *= num_sides;
+            num_slots = (num_roll_codes + 1) << claim_bits;
+        }
+
+        if (num_slots == 0 || num_slots - 1 > INT_MAX) {
+            std::cerr << "Error: A game with " << num_sides << " sides and " << dice_per_player
+                      << " dice per player has infoset keys that do not fit in an int." << std::endl;
+            return false;
+        }
+
+        if (num_slots > max_table_slots) {
+            std::cerr << "Error: A game with " << num_sides << " sides and " << dice_per_player
+                      << " dice per player needs " << num_slots << " infoset table slots, more than "
+                      << max_table_slots << "." << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    // check_game must accept the game.
+    DudoGame(int num_sides, int dice_per_player)
+        : num_sides(num_sides),
+          dice_per_player(dice_per_player),
+          num_actions(2 * dice_per_player * num_sides + 1),
+          dudo(num_actions - 1) {
+        for (int num = 1; num <= 2 * dice_per_player; num++) {
+            for (int rank = 2; rank <= num_sides; rank++) {
+                claim_num.push_back(num);
+                claim_rank.push_back(rank);
+            }
+
+            claim_num.push_back(num);
+            claim_rank.push_back(1);
+        }
+    }
+
+    int count_matches(const std::vector<int>& dice, int rank) const {
+        int count = 0;
+
+        for (int d : dice) {
+            if (d == rank || d == 1) count++;
+        }
+
+        return count;
+    }
+
+    // Each player's dice are sorted, so that rolls differing only in order share infosets.
+    void roll(const Philox& generator, std::vector<int>& dice, uint64_t iteration) const {
+        for (size_t d = 0; d < dice.size(); d++) dice[d] = generator.uniform_int(1, num_sides, iteration, 0, d);
+
+        for (int player = 0; player < 2; player++) {
+            std::sort(dice.begin() + player * dice_per_player, dice.begin() + (player + 1) * dice_per_player);
+        }
+    }
+
+    // Encodes a player's dice as one plus their base-num_sides value, which for a single die is the die itself.
+    int get_roll_code(const std::vector<int>& dice, int player) const {
+        int code = 0;
+
+        for (int d = dice_per_player - 1; d >= 0; d--) {
+            code = code * num_sides + dice[player * dice_per_player + d] - 1;
+        }
+
+        return code + 1;
+    }
+
+    // Utility to player 0 when the claim challenged by a dudo was made by claimant.
+    double get_challenge_utility(const std::vector<int>& dice, int challenged_claim, int claimant) const {
+        int count = count_matches(dice, claim_rank[challenged_claim]);
+        bool claimant_wins = (count >= claim_num[challenged_claim]);
+
+        if (claimant_wins)
+            return (claimant == 0 ? 1.0 : -1.0);
+        else
+            return (claimant == 0 ? -1.0 : 1.0);
+    }
+
+    // First and last legal action after the claims in the bit mask claimed.
+    std::pair<int, int> legal_actions(int claimed) const {
+        if (claimed == 0) return {0, dudo - 1};
+        return {32 - __builtin_clz(claimed), dudo};
+    }
+
+    // Every pair of sorted rolls with its probability.
+    std::vector<Deal> enumerate_deals() const {
+        std::map<std::vector<int>, double> rolls;
+        std::vector<int> dice(dice_per_player, 1);
+        double roll_probability = 1.0;
+        for (int d = 0; d < dice_per_player; d++) roll_probability /= num_sides;
+
+        while (true) {
+            std::vector<int> sorted = dice;
+            std::sort(sorted.begin(), sorted.end());
+            rolls[sorted] += roll_probability;
+
+            int d = 0;
+            while (d < dice_per_player && dice[d] == num_sides) dice[d++] = 1;
+            if (d == dice_per_player) break;
+            dice[d]++;
+        }
+
+        std::vector<Deal> deals;
+        for (auto& [roll0, probability0] : rolls) {
+            for (auto& [roll1, probability1] : rolls) {
+                Deal deal;
+                deal.dice = roll0;
+                deal.dice.insert(deal.dice.end(), roll1.begin(), roll1.end());
+                deal.roll_codes = {get_roll_code(deal.dice, 0), get_roll_code(deal.dice, 1)};
+                deal.probability = probability0 * probability1;
+                deals.push_back(deal);
+            }
+        }
+
+        return deals;
+    }
+};
+
+#endif  // SRC_DUDO_H_
@@ -0,0 +1,405 @@
+// Head-to-head evaluation of trained Kuhn Poker and Dudo strategies: the exact expected value over all deals with
+// each strategy playing both seats, and optionally a simulated value with a 95% confidence interval.
+// Usage: evaluation kuhn <cards> <bet size> <strategy A> <strategy B> [games] [threads]
+//        evaluation dudo <sides> <dice per player> <strategy A> <strategy B> [games] [threads]
+// A strategy is "uniform" or a checkpoint file, which section-3-4, section-3-5-1 and section-3-5-2 write when given
+// a checkpoint file name.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "checkpointer.h"
+#include "dudo.h"
+#include "philox.h"
+
+using namespace std;
+
+// The random words of one simulated game, generated four at a time.
+class GameDraws {
+   private:
+    const Philox& generator;
+    uint64_t game;
+    uint32_t block = 0;
+    array<uint32_t, 4> words;
+    int used = 4;
+
+    uint32_t next() {
+        if (used == 4) {
+            words = generator(game, 0, block++);
+            used = 0;
+        }
+
+        return words[used++];
+    }
+
+   public:
+    GameDraws(const Philox& generator, uint64_t game) : generator(generator), game(game) {}
+
+    // Uniform double in [0, 1) with 32 random bits.
+    double uniform() { return next() * 0x1.0p-32; }
+
+    int uniform_int(int low, int high) { return low + (int)(((uint64_t)next() * (uint64_t)(high - low + 1)) >> 32); }
+};
+
+struct Estimate {
+    double mean, half_width;
+};
+
+// Returns the mean of play(game) over games 0..games-1 with the half-width of its 95% confidence interval.
+template <typename Play>
+Estimate simulate_games(long long games, int num_threads, const Play& play) {
+    vector<double> sums(num_threads, 0.0), squares(num_threads, 0.0);
+    vector<thread> workers;
+
+    for (int t = 0; t < num_threads; t++) {
+        workers.emplace_back([&, t] {
+            double sum = 0, square = 0;
+            for (long long game = games * t / num_threads; game < games * (t + 1) / num_threads; game++) {
+                double payoff = play(game);
+                sum += payoff;
+                square += payoff * payoff;
+            }
+            sums[t] = sum;
+            squares[t] = square;
+        });
+    }
+    for (thread& worker : workers) worker.join();
+
+    double sum = 0, square = 0;
+    for (int t = 0; t < num_threads; t++) {
+        sum += sums[t];
+        square += squares[t];
+    }
+
+    double mean = sum / games;
+    double variance = games > 1 ? max(0.0, square / games - mean * mean) * games / (games - 1) : 0.0;
+    return {mean, 1.96 * sqrt(variance / games)};
+}
+
+// Reads the keys and strategy sums of a trainer checkpoint, dropping its regret sums.
+template <typename Key>
+bool read_checkpoint(const string& filename, int num_actions, vector<Key>& keys, vector<double>& strategy_sums) {
+    typename Checkpointer<Key>::Snapshot snapshot;
+    if (!Checkpointer<Key>::read(filename, num_actions, snapshot)) return false;
+
+    keys = move(snapshot.keys);
+    strategy_sums.resize(keys.size() * num_actions);
+    for (size_t k = 0; k < keys.size(); k++) {
+        auto values = snapshot.values.begin() + k * 2 * num_actions;
+        copy(values + num_actions, values + 2 * num_actions, strategy_sums.begin() + k * num_actions);
+    }
+
+    return true;
+}
+
+class KuhnEvaluation {
+   private:
+    Philox generator{0};
+    int num_cards;
+    double bet_size;
+    // Per strategy, the probability of betting at each infoset, indexed 4 * (card - 1) + history_index(history).
+    array<vector<double>, 2> bet_probability;
+
+    static int history_index(const string& history) {
+        if (history.empty()) return 0;
+        if (history.length() == 2) return 3;
+        return history[0] == 'p' ? 1 : 2;
+    }
+
+    double bet(int strategy, int card, int history) const {
+        return bet_probability[strategy][4 * (card - 1) + history];
+    }
+
+   public:
+    static bool check_game(int num_cards) {
+        if (num_cards < 2) {
+            cerr << "Error: A game needs at least 2 cards." << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    KuhnEvaluation(int num_cards, double bet_size) : num_cards(num_cards), bet_size(bet_size) {}
+
+    // Loads strategy 0 or 1 from a checkpoint, or the uniform strategy when source is "uniform".
+    bool load(int strategy, const string& source) {
+        bet_probability[strategy].assign(4 * num_cards, 0.5);
+        if (source == "uniform") return true;
+
+        vector<string> keys;
+        vector<double> strategy_sums;
+        if (!read_checkpoint(source, 2, keys, strategy_sums)) return false;
+
+        for (size_t k = 0; k < keys.size(); k++) {
+            size_t digits = keys[k].find_first_not_of("0123456789");
+            string history = digits == string::npos ? "" : keys[k].substr(digits);
+            int card = digits == 0 ? 0 : stoi(keys[k].substr(0, digits));
+
+            bool known_history = history == "" || history == "p" || history == "b" || history == "pb";
+            if (card < 1 || card > num_cards || !known_history) {
+                cerr << "Error: Checkpoint " << source << " has infoset " << keys[k] << ", which a " << num_cards
+                     << "-card game does not." << endl;
+                return false;
+            }
+
+            double sum = strategy_sums[2 * k] + strategy_sums[2 * k + 1];
+            if (sum > 0) {
+                bet_probability[strategy][4 * (card - 1) + history_index(history)] = strategy_sums[2 * k + 1] / sum;
+            }
+        }
+
+        return true;
+    }
+
+    // Expected payoff to the strategy seated first, over all deals, using prefix sums over the second player's cards.
+    double exact(int first, int second) const {
+        vector<array<double, 2>> prefix(num_cards + 1, {0, 0});
+        for (int card = 1; card <= num_cards; card++) {
+            prefix[card] = {prefix[card - 1][0] + bet(second, card, 1), prefix[card - 1][1] + bet(second, card, 2)};
+        }
+
+        double total = 0;
+        double showdown_bet = 1.0 + bet_size;
+
+        for (int card = 1; card <= num_cards; card++) {
+            // Second-player sums over the cards below (which lose a showdown) and above (which win it).
+            double below = card - 1, above = num_cards - card;
+            double below_pass_bet = prefix[card - 1][0], above_pass_bet = prefix[num_cards][0] - prefix[card][0];
+            double below_bet_call = prefix[card - 1][1], above_bet_call = prefix[num_cards][1] - prefix[card][1];
+
+            double open_bet = bet(first, card, 0), call = bet(first, card, 3);
+
+            double after_pass = (below - below_pass_bet) - (above - above_pass_bet) +
+                                (below_pass_bet + above_pass_bet) * (1 - call) * -1.0 +
+                                (below_pass_bet - above_pass_bet) * call * showdown_bet;
+            double after_bet = (below - below_bet_call) + (above - above_bet_call) +
+                               (below_bet_call - above_bet_call) * showdown_bet;
+
+            total += (1 - open_bet) * after_pass + open_bet * after_bet;
+        }
+
+        return total / ((double)num_cards * (num_cards - 1));
+    }
+
+    // Returns strategy 0's payoff per simulated game, alternating which strategy sits first.
+    Estimate simulate(long long games, int num_threads) const {
+        return simulate_games(games, num_threads, [&](long long game) {
+            GameDraws draws(generator, game);
+            int seat = game % 2;
+            array<int, 2> strategy = {seat, 1 - seat};
+
+            int card0 = draws.uniform_int(1, num_cards);
+            int card1 = draws.uniform_int(1, num_cards - 1);
+            if (card1 >= card0) card1++;
+            double showdown = card0 > card1 ? 1.0 : -1.0;
+
+            double payoff;
+            if (draws.uniform() < bet(strategy[0], card0, 0)) {
+                payoff = draws.uniform() < bet(strategy[1], card1, 2) ? showdown * (1.0 + bet_size) : 1.0;
+            } else if (draws.uniform() < bet(strategy[1], card1, 1)) {
+                payoff = draws.uniform() < bet(strategy[0], card0, 3) ? showdown * (1.0 + bet_size) : -1.0;
+            } else {
+                payoff = showdown;
+            }
+
+            return seat == 0 ? payoff : -payoff;
+        });
+    }
+};
+
+class DudoEvaluation : private DudoGame {
+   private:
+    Philox generator{0};
+    vector<Deal> deals;
+
+    // Per strategy, the row of each infoset key in probabilities, or -1 where the strategy plays uniformly.
+    array<vector<int>, 2> row_of_key;
+    array<vector<double>, 2> probabilities;
+    // row_of_key has a slot for every possible infoset key; this caps each table at 512 MiB.
+    static constexpr uint64_t MAX_TABLE_SLOTS = uint64_t{1} << 27;
+
+    double probability(int strategy, int key, int action, int first_action, int last_action) const {
+        int row = row_of_key[strategy][key];
+        if (row < 0) return 1.0 / (last_action - first_action + 1);
+        return probabilities[strategy][(size_t)row * num_actions + action];
+    }
+
+    double expected_value(const array<int, 2>& strategy, const Deal& deal, int claimed, int last_action,
+                          int turn) const {
+        if (last_action == dudo) return get_challenge_utility(deal.dice, 31 - __builtin_clz(claimed), turn % 2);
+
+        int player = turn % 2;
+        int key = (deal.roll_codes[player] << (num_actions - 1)) | claimed;
+        auto [first_action, final_action] = legal_actions(claimed);
+        double value = 0;
+
+        for (int a = first_action; a <= final_action; a++) {
+            double p = probability(strategy[player], key, a, first_action, final_action);
+            if (p == 0) continue;
+
+            value += p * expected_value(strategy, deal, a == dudo ? claimed : claimed | (1 << a), a, turn + 1);
+        }
+
+        return value;
+    }
+
+   public:
+    static bool check_game(int num_sides, int dice_per_player) {
+        return DudoGame::check_game(num_sides, dice_per_player, MAX_TABLE_SLOTS);
+    }
+
+    DudoEvaluation(int num_sides, int dice_per_player)
+        : DudoGame(num_sides, dice_per_player), deals(enumerate_deals()) {}
+
+    // Strategy sums are normalized over the legal actions only.
+    bool load(int strategy, const string& source) {
+        int num_roll_codes = 1;
+        for (int d = 0; d < dice_per_player; d++) num_roll_codes *= num_sides;
+        row_of_key[strategy].assign((size_t)(num_roll_codes + 1) << (num_actions - 1), -1);
+        probabilities[strategy].clear();
+        if (source == "uniform") return true;
+
+        vector<int> keys;
+        vector<double> strategy_sums;
+        if (!read_checkpoint(source, num_actions, keys, strategy_sums)) return false;
+
+        for (size_t k = 0; k < keys.size(); k++) {
+            if (keys[k] < 0 || (size_t)keys[k] >= row_of_key[strategy].size()) {
+                cerr << "Error: Checkpoint " << source << " has infoset key " << keys[k] << ", which a game with "
+                     << num_sides << " sides and " << dice_per_player << " dice per player does not." << endl;
+                return false;
+            }
+
+            auto [first_action, final_action] = legal_actions(keys[k] & ((1 << (num_actions - 1)) - 1));
+            const double* sums = &strategy_sums[k * num_actions];
+            double sum = 0;
+            for (int a = first_action; a <= final_action; a++) sum += sums[a];
+            if (sum <= 0) continue;
+
+            row_of_key[strategy][keys[k]] = probabilities[strategy].size() / num_actions;
+            for (int a = 0; a < num_actions; a++) {
+                bool legal = a >= first_action && a <= final_action;
+                probabilities[strategy].push_back(legal ? sums[a] / sum : 0.0);
+            }
+        }
+
+        return true;
+    }
+
+    // Expected payoff to the strategy seated first, over all deals.
+    double exact(int first, int second, int num_threads) const {
+        vector<double> values(num_threads, 0.0);
+        vector<thread> workers;
+
+        for (int t = 0; t < num_threads; t++) {
+            workers.emplace_back([&, t] {
+                for (size_t d = t; d < deals.size(); d += num_threads) {
+                    values[t] += deals[d].probability * expected_value({first, second}, deals[d], 0, -1, 0);
+                }
+            });
+        }
+        for (thread& worker : workers) worker.join();
+
+        double value = 0;
+        for (double v : values) value += v;
+        return value;
+    }
+
+    Estimate simulate(long long games, int num_threads) const {
+        return simulate_games(games, num_threads, [&](long long game) {
+            GameDraws draws(generator, game);
+            int seat = game % 2;
+            array<int, 2> strategy = {seat, 1 - seat};
+
+            vector<int> dice(2 * dice_per_player);
+            for (int& die : dice) die = draws.uniform_int(1, num_sides);
+            for (int player = 0; player < 2; player++) {
+                sort(dice.begin() + player * dice_per_player, dice.begin() + (player + 1) * dice_per_player);
+            }
+            array<int, 2> roll_codes = {get_roll_code(dice, 0), get_roll_code(dice, 1)};
+
+            int claimed = 0;
+            for (int turn = 0;; turn++) {
+                int player = turn % 2;
+                int key = (roll_codes[player] << (num_actions - 1)) | claimed;
+                auto [first_action, final_action] = legal_actions(claimed);
+
+                double r = draws.uniform();
+                int action = final_action;
+                for (int a = first_action; a < final_action; a++) {
+                    r -= probability(strategy[player], key, a, first_action, final_action);
+                    if (r < 0) {
+                        action = a;
+                        break;
+                    }
+                }
+
+                if (action == dudo) {
+                    double payoff = get_challenge_utility(dice, 31 - __builtin_clz(claimed), (turn + 1) % 2);
+                    return seat == 0 ? payoff : -payoff;
+                }
+                claimed |= 1 << action;
+            }
+        });
+    }
+};
+
+// Prints strategy A's exact value in each seat and overall, then its simulated value when games is positive.
+template <typename Evaluation, typename Exact>
+void report(const Evaluation& evaluation, const Exact& exact, long long games, int num_threads) {
+    double as_first = exact(0, 1), as_second = -exact(1, 0);
+    cout << fixed << setprecision(6);
+    cout << "Exact value of A against B: " << (as_first + as_second) / 2 << " (as player 1: " << as_first
+         << ", as player 2: " << as_second << ")" << endl;
+
+    if (games <= 0) return;
+
+    auto start = chrono::steady_clock::now();
+    Estimate estimate = evaluation.simulate(games, num_threads);
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    cout << "Simulated value of A against B: " << estimate.mean << " +/- " << estimate.half_width << " (95%, "
+         << games << " games on " << num_threads << " threads in " << setprecision(2) << elapsed.count() << " s)"
+         << endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 6 || (string(argv[1]) != "kuhn" && string(argv[1]) != "dudo")) {
+        cerr << "Error: Expected kuhn <cards> <bet size> or dudo <sides> <dice per player>, followed by two strategies"
+             << " and optionally a game count and a thread count." << endl;
+        return 1;
+    }
+
+    long long games = argc > 6 ? stoll(argv[6]) : 0;
+    int num_threads = argc > 7 ? stoi(argv[7]) : max(1u, thread::hardware_concurrency());
+
+    if (string(argv[1]) == "kuhn") {
+        int num_cards = stoi(argv[2]);
+        if (!KuhnEvaluation::check_game(num_cards)) return 1;
+
+        KuhnEvaluation evaluation = KuhnEvaluation(num_cards, stod(argv[3]));
+        if (!evaluation.load(0, argv[4]) || !evaluation.load(1, argv[5])) return 1;
+
+        report(evaluation, [&](int first, int second) { return evaluation.exact(first, second); }, games, num_threads);
+    } else {
+        int num_sides = stoi(argv[2]), dice_per_player = stoi(argv[3]);
+        if (!DudoEvaluation::check_game(num_sides, dice_per_player)) return 1;
+
+        DudoEvaluation evaluation = DudoEvaluation(num_sides, dice_per_player);
+        if (!evaluation.load(0, argv[4]) || !evaluation.load(1, argv[5])) return 1;
+
+        report(evaluation, [&](int first, int second) { return evaluation.exact(first, second, num_threads); }, games,
+               num_threads);
+    }
+
+    return 0;
+}
@@ -0,0 +1,433 @@
+// Two-player regret matching with exact expected utilities for normal-form games loaded from a binary file.
+// Build with -O3 -march=native -pthread for the AVX2 kernel.
+// Usage: normal-form-solver <payoff file> [iterations] [threads]
+//        normal-form-solver --generate <payoff file> <rows> <columns>
+// Without arguments, writes Rock-Paper-Scissors to rps.bin and solves it.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "philox.h"
+
+using namespace std;
+
+// Read-only view of a payoff file mapped into memory, laid out in row-major order as:
+//     char magic[8] = "NFGAME1";
+//     uint64_t rows, columns, flags;
+//     double row_payoffs[rows * columns];
+//     double column_payoffs[rows * columns];
+class PayoffMatrix {
+   public:
+    static constexpr uint64_t ZERO_SUM = 1;
+
+   private:
+    static constexpr char MAGIC[8] = "NFGAME1";
+    void* mapping = MAP_FAILED;
+    size_t mapping_size = 0;
+
+   public:
+    int64_t rows = 0, columns = 0;
+    bool zero_sum = false;
+    const double* row_payoffs = nullptr;
+    // For zero-sum games this aliases row_payoffs, and the column player's payoffs are its negation.
+    const double* column_payoffs = nullptr;
+
+    PayoffMatrix() = default;
+    PayoffMatrix(const PayoffMatrix&) = delete;
+    PayoffMatrix& operator=(const PayoffMatrix&) = delete;
+
+    ~PayoffMatrix() {
+        if (mapping != MAP_FAILED) munmap(mapping, mapping_size);
+    }
+
+    bool open(const string& filename) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            cerr << "Error: Could not open file " << filename << " for reading." << endl;
+            return false;
+        }
+
+        struct stat status;
+        if (fstat(fd, &status) != 0 || (size_t)status.st_size < 32) {
+            cerr << "Error: Payoff file " << filename << " is too short for its header." << endl;
+            close(fd);
+            return false;
+        }
+
+        mapping_size = status.st_size;
+        mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            cerr << "Error: Could not map payoff file " << filename << "." << endl;
+            return false;
+        }
+
+        const char* bytes = static_cast<const char*>(mapping);
+        uint64_t header[3];
+        memcpy(header, bytes + sizeof(MAGIC), sizeof(header));
+        rows = header[0];
+        columns = header[1];
+        zero_sum = header[2] & ZERO_SUM;
+
+        uint64_t num_matrices = zero_sum ? 1 : 2, max_entries = (SIZE_MAX - 32) / (num_matrices * sizeof(double));
+        if (memcmp(bytes, MAGIC, sizeof(MAGIC)) != 0 || rows <= 0 || columns <= 0 ||
+            (uint64_t)rows > max_entries / (uint64_t)columns ||
+            mapping_size != 32 + num_matrices * rows * columns * sizeof(double)) {
+            cerr << "Error: " << filename << " is not a valid payoff file." << endl;
+            return false;
+        }
+
+        row_payoffs = reinterpret_cast<const double*>(bytes + 32);
+        column_payoffs = zero_sum ? row_payoffs : row_payoffs + rows * columns;
+        // Column blocks jump from row to row, so ask for the file to stay resident rather than for readahead.
+        madvise(mapping, mapping_size, MADV_WILLNEED);
+
+        return true;
+    }
+
+    // Writes a payoff file. Leave column_payoffs empty for a zero-sum game.
+    static bool write(const string& filename, int64_t rows, int64_t columns, const vector<double>& row_payoffs,
+                      const vector<double>& column_payoffs) {
+        ofstream outfile(filename, ios::binary);
+
+        if (!outfile.is_open()) {
+            cerr << "Error: Could not open file " << filename << " for writing." << endl;
+            return false;
+        }
+
+        uint64_t header[3] = {(uint64_t)rows, (uint64_t)columns, column_payoffs.empty() ? ZERO_SUM : 0};
+        outfile.write(MAGIC, sizeof(MAGIC));
+        outfile.write(reinterpret_cast<const char*>(header), sizeof(header));
+        outfile.write(reinterpret_cast<const char*>(row_payoffs.data()), row_payoffs.size() * sizeof(double));
+        outfile.write(reinterpret_cast<const char*>(column_payoffs.data()), column_payoffs.size() * sizeof(double));
+
+        if (!outfile) {
+            cerr << "Error: Could not write payoff file " << filename << "." << endl;
+            return false;
+        }
+
+        return true;
+    }
+};
+
+// Returns the dot product of a and y over n entries, and adds scale * b to out.
+double dot_and_axpy(const double* a, const double* b, const double* y, double scale, double* out, int n) {
+    int k = 0;
+    double dot = 0;
+
+#if defined(__AVX2__) && defined(__FMA__)
+    __m256d sum0 = _mm256_setzero_pd(), sum1 = _mm256_setzero_pd();
+    __m256d factor = _mm256_set1_pd(scale);
+
+    for (; k + 8 <= n; k += 8) {
+        sum0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + k), _mm256_loadu_pd(y + k), sum0);
+        sum1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + k + 4), _mm256_loadu_pd(y + k + 4), sum1);
+        _mm256_storeu_pd(out + k, _mm256_fmadd_pd(_mm256_loadu_pd(b + k), factor, _mm256_loadu_pd(out + k)));
+        _mm256_storeu_pd(out + k + 4,
+                         _mm256_fmadd_pd(_mm256_loadu_pd(b + k + 4), factor, _mm256_loadu_pd(out + k + 4)));
+    }
+
+    __m256d sum = _mm256_add_pd(sum0, sum1);
+    __m128d half = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+    dot = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+#else
+    double sum[4] = {0};
+
+    for (; k + 4 <= n; k += 4) {
+        for (int lane = 0; lane < 4; lane++) {
+            sum[lane] += a[k + lane] * y[k + lane];
+            out[k + lane] += scale * b[k + lane];
+        }
+    }
+
+    dot = (sum[0] + sum[1]) + (sum[2] + sum[3]);
+#endif
+
+    for (; k < n; k++) {
+        dot += a[k] * y[k];
+        out[k] += scale * b[k];
+    }
+
+    return dot;
+}
+
+class NormalFormSolver {
+   private:
+    // Columns per cache block, so a block's slices of the strategy and partial products stay in L1.
+    static constexpr int BLOCK_COLUMNS = 512;
+    // Rows below which another thread costs more to wake than it saves.
+    static constexpr int64_t MIN_ROWS_PER_THREAD = 64;
+
+    const PayoffMatrix& payoffs;
+    int num_threads;
+
+    vector<double> row_regret_sum, column_regret_sum;
+    vector<double> row_strategy, column_strategy;
+    vector<double> row_strategy_sum, column_strategy_sum;
+    vector<double> row_utility, column_utility;
+    // Per thread, its rows' contribution to the column player's utilities.
+    vector<vector<double>> partial_column_utility;
+
+    // Threads 1 to num_threads - 1 run their rows of every multiply; the calling thread takes thread 0's rows.
+    vector<thread> workers;
+    mutex lock;
+    condition_variable changed;
+    long long generation = 0;
+    int busy_workers = 0;
+    bool stopping = false;
+    const double *job_x = nullptr, *job_y = nullptr;
+    double* job_row_out = nullptr;
+
+    static void get_strategy(const vector<double>& regret_sum, vector<double>& strategy) {
+        double sum = 0.0;
+
+        for (size_t a = 0; a < strategy.size(); a++) {
+            strategy[a] = regret_sum[a] > 0 ? regret_sum[a] : 0;
+            sum += strategy[a];
+        }
+
+        for (size_t a = 0; a < strategy.size(); a++) {
+            if (sum > 0)
+                strategy[a] /= sum;
+            else
+                strategy[a] = 1.0 / strategy.size();
+        }
+    }
+
+    static void normalize(const vector<double>& strategy_sum, vector<double>& strategy) {
+        double sum = 0;
+        for (double s : strategy_sum) sum += s;
+
+        for (size_t a = 0; a < strategy.size(); a++) {
+            strategy[a] = sum > 0 ? strategy_sum[a] / sum : 1.0 / strategy.size();
+        }
+    }
+
+    void multiply_rows(int thread, int64_t first_row, int64_t last_row, const double* x, const double* y,
+                       double* row_out) {
+        double* column_out = partial_column_utility[thread].data();
+        fill(row_out + first_row, row_out + last_row, 0.0);
+        fill(column_out, column_out + payoffs.columns, 0.0);
+
+        for (int64_t block = 0; block < payoffs.columns; block += BLOCK_COLUMNS) {
+            int width = min<int64_t>(BLOCK_COLUMNS, payoffs.columns - block);
+
+            for (int64_t i = first_row; i < last_row; i++) {
+                const double* a = payoffs.row_payoffs + i * payoffs.columns + block;
+                const double* b = payoffs.column_payoffs + i * payoffs.columns + block;
+                row_out[i] += dot_and_axpy(a, b, y + block, x[i], column_out + block, width);
+            }
+        }
+    }
+
+    int64_t get_first_row(int thread) const { return payoffs.rows * thread / num_threads; }
+
+    void work(int thread) {
+        long long done = 0;
+
+        while (true) {
+            {
+                unique_lock<mutex> guard(lock);
+                changed.wait(guard, [&] { return stopping || generation != done; });
+                if (stopping) return;
+                done = generation;
+            }
+
+            multiply_rows(thread, get_first_row(thread), get_first_row(thread + 1), job_x, job_y, job_row_out);
+
+            {
+                lock_guard<mutex> guard(lock);
+                busy_workers--;
+            }
+            changed.notify_all();
+        }
+    }
+
+    // Sets row_out to A * y and column_out to B^T * x in a single pass over the matrices.
+    void multiply(const vector<double>& x, const vector<double>& y, vector<double>& row_out,
+                  vector<double>& column_out) {
+        if (!workers.empty()) {
+            {
+                lock_guard<mutex> guard(lock);
+                job_x = x.data();
+                job_y = y.data();
+                job_row_out = row_out.data();
+                busy_workers = workers.size();
+                generation++;
+            }
+            changed.notify_all();
+        }
+
+        multiply_rows(0, 0, get_first_row(1), x.data(), y.data(), row_out.data());
+
+        if (!workers.empty()) {
+            unique_lock<mutex> guard(lock);
+            changed.wait(guard, [&] { return busy_workers == 0; });
+        }
+
+        double sign = payoffs.zero_sum ? -1.0 : 1.0;
+        for (int64_t j = 0; j < payoffs.columns; j++) {
+            double sum = 0;
+            for (int t = 0; t < num_threads; t++) sum += partial_column_utility[t][j];
+            column_out[j] = sign * sum;
+        }
+    }
+
+    static double dot(const vector<double>& u, const vector<double>& v) {
+        double sum = 0;
+        for (size_t k = 0; k < u.size(); k++) sum += u[k] * v[k];
+        return sum;
+    }
+
+   public:
+    NormalFormSolver(const PayoffMatrix& payoffs, int num_threads)
+        : payoffs(payoffs),
+          num_threads((int)max<int64_t>(1, min<int64_t>(num_threads, payoffs.rows / MIN_ROWS_PER_THREAD))),
+          row_regret_sum(payoffs.rows, 0.0),
+          column_regret_sum(payoffs.columns, 0.0),
+          row_strategy(payoffs.rows, 0.0),
+          column_strategy(payoffs.columns, 0.0),
+          row_strategy_sum(payoffs.rows, 0.0),
+          column_strategy_sum(payoffs.columns, 0.0),
+          row_utility(payoffs.rows, 0.0),
+          column_utility(payoffs.columns, 0.0),
+          partial_column_utility(this->num_threads, vector<double>(payoffs.columns, 0.0)) {
+        for (int t = 1; t < this->num_threads; t++) workers.emplace_back(&NormalFormSolver::work, this, t);
+    }
+
+    ~NormalFormSolver() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        changed.notify_all();
+        for (thread& worker : workers) worker.join();
+    }
+
+    void train(int iterations) {
+        for (int i = 0; i < iterations; i++) {
+            get_strategy(row_regret_sum, row_strategy);
+            get_strategy(column_regret_sum, column_strategy);
+            multiply(row_strategy, column_strategy, row_utility, column_utility);
+
+            double row_value = dot(row_strategy, row_utility);
+            double column_value = dot(column_strategy, column_utility);
+
+            for (int64_t a = 0; a < payoffs.rows; a++) {
+                row_regret_sum[a] += row_utility[a] - row_value;
+                row_strategy_sum[a] += row_strategy[a];
+            }
+
+            for (int64_t a = 0; a < payoffs.columns; a++) {
+                column_regret_sum[a] += column_utility[a] - column_value;
+                column_strategy_sum[a] += column_strategy[a];
+            }
+        }
+    }
+
+    vector<double> get_average_strategy(int player) {
+        vector<double> strategy(player == 0 ? payoffs.rows : payoffs.columns);
+        normalize(player == 0 ? row_strategy_sum : column_strategy_sum, strategy);
+        return strategy;
+    }
+
+    // Returns each player's expected payoff under the average strategies, and sets exploitability to the sum of what
+    // each could gain by deviating to a best response.
+    array<double, 2> evaluate(double& exploitability) {
+        vector<double> x = get_average_strategy(0), y = get_average_strategy(1);
+        multiply(x, y, row_utility, column_utility);
+
+        array<double, 2> value = {dot(x, row_utility), dot(y, column_utility)};
+        exploitability = *max_element(row_utility.begin(), row_utility.end()) - value[0] +
+                         *max_element(column_utility.begin(), column_utility.end()) - value[1];
+
+        return value;
+    }
+};
+
+// Writes a zero-sum game with payoffs drawn uniformly from [-1, 1].
+bool generate(const string& filename, int64_t rows, int64_t columns) {
+    Philox generator{0};
+    vector<double> row_payoffs(rows * columns);
+
+    for (int64_t i = 0; i < rows; i++) {
+        for (int64_t j = 0; j < columns; j++) {
+            row_payoffs[i * columns + j] = 2 * generator.uniform(i, 0, j) - 1;
+        }
+    }
+
+    return PayoffMatrix::write(filename, rows, columns, row_payoffs, {});
+}
+
+void print_strategy(const string& name, const vector<double>& strategy) {
+    vector<int> order(strategy.size());
+    for (size_t a = 0; a < order.size(); a++) order[a] = a;
+    sort(order.begin(), order.end(), [&](int a, int b) { return strategy[a] > strategy[b]; });
+
+    int support = count_if(strategy.begin(), strategy.end(), [](double p) { return p > 0.001; });
+    cout << name << " strategy, " << support << " of " << strategy.size() << " actions above 0.1%:" << endl;
+
+    for (int k = 0; k < min(support, 10); k++) {
+        cout << "    " << order[k] << ": " << fixed << setprecision(2) << strategy[order[k]] * 100 << '%' << endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "--generate") {
+        if (argc != 5) {
+            cerr << "Error: --generate takes a file name, a row count and a column count." << endl;
+            return 1;
+        }
+        return generate(argv[2], stoll(argv[3]), stoll(argv[4])) ? 0 : 1;
+    }
+
+    string filename = "rps.bin";
+    if (argc > 1) {
+        filename = argv[1];
+    } else if (!PayoffMatrix::write(filename, 3, 3, {0, -1, 1, 1, 0, -1, -1, 1, 0}, {})) {
+        return 1;
+    }
+
+    int iterations = argc > 2 ? stoi(argv[2]) : 100'000;
+    int num_threads = argc > 3 ? stoi(argv[3]) : max(1u, thread::hardware_concurrency());
+
+    PayoffMatrix payoffs;
+    if (!payoffs.open(filename)) return 1;
+
+    NormalFormSolver solver = NormalFormSolver(payoffs, num_threads);
+    auto start = chrono::steady_clock::now();
+    solver.train(iterations);
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    double exploitability;
+    array<double, 2> value = solver.evaluate(exploitability);
+
+    cout << payoffs.rows << " x " << payoffs.columns << (payoffs.zero_sum ? " zero-sum" : "") << " game, "
+         << iterations << " iterations in " << fixed << setprecision(2) << elapsed.count() << " s" << endl;
+    cout << "Game value: " << setprecision(6) << value[0] << ", " << value[1] << endl;
+    cout << "Exploitability: " << exploitability << endl;
+    print_strategy("Row player", solver.get_average_strategy(0));
+    print_strategy("Column player", solver.get_average_strategy(1));
+
+    return 0;
+}
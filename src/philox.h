@@ -0,0 +1,47 @@
+// Counter-based random number generator shared by all trainers.
+
+#ifndef SRC_PHILOX_H_
+#define SRC_PHILOX_H_
+
+#include <array>
+#include <cstdint>
+
+// Counter-based Philox4x32-10 generator. Every draw is a pure function of (seed, iteration, purpose, index), so any
+// iteration's samples can be generated independently, in any order and on any thread, with identical results.
+class Philox {
+   private:
+    static constexpr uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57, W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+    uint64_t seed;
+
+   public:
+    Philox(uint64_t seed) : seed(seed) {}
+
+    std::array<uint32_t, 4> operator()(uint64_t iteration, uint32_t purpose, uint32_t index) const {
+        std::array<uint32_t, 4> counter = {(uint32_t)iteration, (uint32_t)(iteration >> 32), purpose, index};
+        uint32_t k0 = (uint32_t)seed, k1 = (uint32_t)(seed >> 32);
+
+        for (int round = 0; round < 10; round++) {
+            uint64_t product0 = (uint64_t)M0 * counter[0];
+            uint64_t product1 = (uint64_t)M1 * counter[2];
+            counter = {(uint32_t)(product1 >> 32) ^ counter[1] ^ k0, (uint32_t)product1,
+                       (uint32_t)(product0 >> 32) ^ counter[3] ^ k1, (uint32_t)product0};
+            k0 += W0;
+            k1 += W1;
+        }
+
+        return counter;
+    }
+
+    // Uniform double in [0, 1) built from 53 random bits.
+    double uniform(uint64_t iteration, uint32_t purpose, uint32_t index) const {
+        std::array<uint32_t, 4> bits = (*this)(iteration, purpose, index);
+        return (((uint64_t)bits[0] << 21) ^ (bits[1] >> 11)) * 0x1.0p-53;
+    }
+
+    // Uniform integer in [low, high].
+    int uniform_int(int low, int high, uint64_t iteration, uint32_t purpose, uint32_t index) const {
+        return low + (int)(uniform(iteration, purpose, index) * (high - low + 1));
+    }
+};
+
+#endif  // SRC_PHILOX_H_
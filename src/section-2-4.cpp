@@ -3,17 +3,20 @@
 // Adapted from "An Introduction to Counterfactual Regret Minimization" by Todd W. Neller and Marc Lanctot
 
 #include <array>
+#include <cstdint>
 #include <cstdlib>
 #include <iomanip>
 #include <iostream>
-#include <random>
+
+#include "philox.h"
 
 using namespace std;
 
 class RPS {
    private:
-    mt19937 generator;
+    Philox generator;
     enum class ACTION { ROCK = 0, PAPER, SCISSORS };
+    enum class STREAM : uint32_t { MY_ACTION = 0, OPPONENTS_ACTION };
 
     static constexpr int NUMBER_OF_ACTIONS = 3;
 
@@ -42,10 +45,20 @@ class RPS {
         return strategy;
     }
 
-    ACTION get_action(array<double, NUMBER_OF_ACTIONS> strategy) {
-        discrete_distribution<> distribution(strategy.begin(), strategy.end());
+    ACTION get_action(const array<double, NUMBER_OF_ACTIONS>& strategy, uint64_t iteration, STREAM stream) {
+        double sum = 0;
+        for (int a = 0; a < NUMBER_OF_ACTIONS; a++) sum += strategy[a];
+
+        double r = generator.uniform(iteration, (uint32_t)stream, 0) * sum;
+        int action_index = 0;
+
+        for (int a = 0; a < NUMBER_OF_ACTIONS; a++) {
+            if (strategy[a] <= 0) continue;
+            action_index = a;
+            if (r < strategy[a]) break;
+            r -= strategy[a];
+        }
 
-        int action_index = distribution(generator);
         return static_cast<ACTION>(action_index);
     }
 
@@ -70,8 +83,8 @@ class RPS {
 
         for (int i = 0; i < iterations; i++) {
             array<double, NUMBER_OF_ACTIONS> strategy = get_strategy();
-            ACTION my_action = get_action(strategy);
-            ACTION opponents_action = get_action(opponents_strategy);
+            ACTION my_action = get_action(strategy, i, STREAM::MY_ACTION);
+            ACTION opponents_action = get_action(opponents_strategy, i, STREAM::OPPONENTS_ACTION);
 
             action_utility[(int)opponents_action] = 0;
             action_utility[(int)opponents_action == NUMBER_OF_ACTIONS - 1 ? 0 : (int)opponents_action + 1] = 1;
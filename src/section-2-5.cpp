@@ -1,27 +1,39 @@
 // Section 2.5
 // Two-player regret matching algorithm for Rock-Paper-Scissors game.
 // Exercise from "An Introduction to Counterfactual Regret Minimization" by Todd W. Neller and Marc Lanctot
+// Usage: section-2-5 [rm|rm+|prm+] [--alternating] [--last-iterate]
 
 #include <array>
+#include <cstdint>
 #include <cstdlib>
 #include <iomanip>
 #include <iostream>
-#include <random>
+#include <string>
+
+#include "philox.h"
 
 using namespace std;
 
 static constexpr int NUMBER_OF_ACTIONS = 3;
 
+// REGRET_MATCHING plays the positive part of the cumulative regrets. REGRET_MATCHING_PLUS additionally floors the
+// cumulative regrets at zero after every update, and PREDICTIVE_REGRET_MATCHING_PLUS also adds the last instantaneous
+// regrets as a prediction of the next ones when choosing the strategy.
+enum class UPDATE_RULE { REGRET_MATCHING, REGRET_MATCHING_PLUS, PREDICTIVE_REGRET_MATCHING_PLUS };
+
 class Player {
    public:
     array<double, NUMBER_OF_ACTIONS> regret_sum = {0};
     array<double, NUMBER_OF_ACTIONS> strategy = {0};
+    array<double, NUMBER_OF_ACTIONS> prediction = {0};
 
-    array<double, NUMBER_OF_ACTIONS> get_strategy() {
+    const array<double, NUMBER_OF_ACTIONS>& get_strategy(UPDATE_RULE rule = UPDATE_RULE::REGRET_MATCHING) {
+        bool predictive = rule == UPDATE_RULE::PREDICTIVE_REGRET_MATCHING_PLUS;
         double sum = 0.0;
 
         for (int a = 0; a < NUMBER_OF_ACTIONS; a++) {
-            strategy[a] = regret_sum[a] > 0 ? regret_sum[a] : 0;
+            double regret = predictive ? regret_sum[a] + prediction[a] : regret_sum[a];
+            strategy[a] = regret > 0 ? regret : 0;
             sum += strategy[a];
         }
 
@@ -34,17 +46,41 @@ class Player {
 
         return strategy;
     }
+
+    // Accumulates the regrets of the current strategy against the given expected utilities of each action.
+    void update(const array<double, NUMBER_OF_ACTIONS>& utility, UPDATE_RULE rule) {
+        double value = 0;
+        for (int a = 0; a < NUMBER_OF_ACTIONS; a++) value += strategy[a] * utility[a];
+
+        for (int a = 0; a < NUMBER_OF_ACTIONS; a++) {
+            double regret = utility[a] - value;
+            regret_sum[a] += regret;
+            if (rule != UPDATE_RULE::REGRET_MATCHING && regret_sum[a] < 0) regret_sum[a] = 0;
+            if (rule == UPDATE_RULE::PREDICTIVE_REGRET_MATCHING_PLUS) prediction[a] = regret;
+        }
+    }
 };
 
 class RPS {
    private:
-    mt19937 generator;
+    Philox generator;
     enum class ACTION { ROCK = 0, PAPER, SCISSORS };
+    enum class STREAM : uint32_t { PLAYER1_ACTION = 0, PLAYER2_ACTION, PLAYER1_UPDATED_ACTION };
 
-    ACTION get_action(array<double, NUMBER_OF_ACTIONS>& strategy) {
-        discrete_distribution<> distribution(strategy.begin(), strategy.end());
+    ACTION get_action(const array<double, NUMBER_OF_ACTIONS>& strategy, uint64_t iteration, STREAM stream) {
+        double sum = 0;
+        for (int a = 0; a < NUMBER_OF_ACTIONS; a++) sum += strategy[a];
+
+        double r = generator.uniform(iteration, (uint32_t)stream, 0) * sum;
+        int action_index = 0;
+
+        for (int a = 0; a < NUMBER_OF_ACTIONS; a++) {
+            if (strategy[a] <= 0) continue;
+            action_index = a;
+            if (r < strategy[a]) break;
+            r -= strategy[a];
+        }
 
-        int action_index = distribution(generator);
         return static_cast<ACTION>(action_index);
     }
 
@@ -67,6 +103,17 @@ class RPS {
         return utility;
     }
 
+    // Expected utility of each action against a mixed opponent strategy.
+    void calculate_expected_utility(const array<double, NUMBER_OF_ACTIONS>& opponent_strategy,
+                                    array<double, NUMBER_OF_ACTIONS>& utility) {
+        utility.fill(0);
+
+        for (int b = 0; b < NUMBER_OF_ACTIONS; b++) {
+            auto u = calculate_actions_utility(static_cast<ACTION>(b));
+            for (int a = 0; a < NUMBER_OF_ACTIONS; a++) utility[a] += opponent_strategy[b] * u[a];
+        }
+    }
+
     array<double, NUMBER_OF_ACTIONS> get_average_strategy(array<double, NUMBER_OF_ACTIONS>& strategy_sum) {
         array<double, NUMBER_OF_ACTIONS> average_strategy;
         double sum = 0;
@@ -85,39 +132,85 @@ class RPS {
    public:
     RPS() : generator(0) {}
 
-    array<double, NUMBER_OF_ACTIONS> train(int iterations) {
+    // Plain regret matching samples actions, as in the book; the plus rules use expected utilities and linear
+    // averaging. With alternating, player 2 responds to player 1's already updated strategy.
+    array<double, NUMBER_OF_ACTIONS> train(int iterations, UPDATE_RULE rule = UPDATE_RULE::REGRET_MATCHING,
+                                           bool alternating = false, bool last_iterate = false) {
         Player player1;
         Player player2;
 
         array<double, NUMBER_OF_ACTIONS> strategy_sum1 = {0};
+        array<double, NUMBER_OF_ACTIONS> u1, u2;
 
         for (int i = 0; i < iterations; i++) {
-            auto strategy1 = player1.get_strategy();
-            auto strategy2 = player2.get_strategy();
+            const auto& strategy1 = player1.get_strategy(rule);
+            const auto& strategy2 = player2.get_strategy(rule);
+            double weight = rule == UPDATE_RULE::REGRET_MATCHING ? 1.0 : i + 1.0;
 
             for (int a = 0; a < NUMBER_OF_ACTIONS; a++) {
-                strategy_sum1[a] += strategy1[a];
+                strategy_sum1[a] += weight * strategy1[a];
             }
 
-            ACTION action1 = get_action(strategy1);
-            ACTION action2 = get_action(strategy2);
+            if (rule != UPDATE_RULE::REGRET_MATCHING) {
+                calculate_expected_utility(strategy2, u1);
+                if (!alternating) calculate_expected_utility(strategy1, u2);
+                player1.update(u1, rule);
 
-            auto u1 = calculate_actions_utility(action2);
-            auto u2 = calculate_actions_utility(action1);
-
-            for (int a = 0; a < NUMBER_OF_ACTIONS; a++) {
-                player1.regret_sum[a] += u1[a] - u1[(int)action1];
-                player2.regret_sum[a] += u2[a] - u2[(int)action2];
+                if (alternating) calculate_expected_utility(player1.get_strategy(rule), u2);
+                player2.update(u2, rule);
+                continue;
             }
+
+            ACTION action1 = get_action(strategy1, i, STREAM::PLAYER1_ACTION);
+            ACTION action2 = get_action(strategy2, i, STREAM::PLAYER2_ACTION);
+
+            u1 = calculate_actions_utility(action2);
+            for (int a = 0; a < NUMBER_OF_ACTIONS; a++) player1.regret_sum[a] += u1[a] - u1[(int)action1];
+
+            if (alternating) action1 = get_action(player1.get_strategy(rule), i, STREAM::PLAYER1_UPDATED_ACTION);
+            u2 = calculate_actions_utility(action1);
+            for (int a = 0; a < NUMBER_OF_ACTIONS; a++) player2.regret_sum[a] += u2[a] - u2[(int)action2];
         }
 
+        if (last_iterate) return player1.get_strategy(rule);
         return get_average_strategy(strategy_sum1);
     }
 };
 
-int main() {
+// Reads the optional update rule and flags of main's usage line.
+bool parse_arguments(int argc, char* argv[], UPDATE_RULE& rule, bool& alternating, bool& last_iterate) {
+    rule = UPDATE_RULE::REGRET_MATCHING;
+    alternating = last_iterate = false;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (i == 1 && arg == "rm") {
+            rule = UPDATE_RULE::REGRET_MATCHING;
+        } else if (i == 1 && arg == "rm+") {
+            rule = UPDATE_RULE::REGRET_MATCHING_PLUS;
+        } else if (i == 1 && arg == "prm+") {
+            rule = UPDATE_RULE::PREDICTIVE_REGRET_MATCHING_PLUS;
+        } else if (arg == "--alternating") {
+            alternating = true;
+        } else if (arg == "--last-iterate") {
+            last_iterate = true;
+        } else {
+            cerr << "Error: Unknown argument " << arg << "." << endl;
+            cerr << "Usage: section-2-5 [rm|rm+|prm+] [--alternating] [--last-iterate]" << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    UPDATE_RULE rule;
+    bool alternating, last_iterate;
+    if (!parse_arguments(argc, argv, rule, alternating, last_iterate)) return 1;
+
     RPS rps;
-    auto result = rps.train(1000000);
+    auto result = rps.train(1000000, rule, alternating, last_iterate);
 
     cout << fixed << setprecision(2);
     for (int i = 0; i < result.size(); i++) cout << result[i] << endl;
@@ -1,30 +1,47 @@
 // Section 2.6
 // Two-player regret matching algorithm for Colonel Blotto game.
 // Exercise from "An Introduction to Counterfactual Regret Minimization" by Todd W. Neller and Marc Lanctot
+// Usage: section-2-6 [rm|rm+|prm+] [--alternating] [--last-iterate]
 
 #include <algorithm>
+#include <array>
+#include <cstdint>
 #include <functional>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <numeric>
-#include <random>
+#include <set>
+#include <string>
 #include <vector>
 
+#include "philox.h"
+
 using namespace std;
 
+enum class UPDATE_RULE { REGRET_MATCHING, REGRET_MATCHING_PLUS, PREDICTIVE_REGRET_MATCHING_PLUS };
+
 class Player {
    public:
     vector<double> regret_sum;
     vector<double> strategy;
+    vector<double> prediction;
     int num_actions;
 
-    Player(int num_actions) : regret_sum(num_actions, 0.0), strategy(num_actions, 0.0), num_actions(num_actions) {}
+    Player(int num_actions)
+        : regret_sum(num_actions, 0.0),
+          strategy(num_actions, 0.0),
+          prediction(num_actions, 0.0),
+          num_actions(num_actions) {}
 
-    vector<double> get_strategy() {
+    const vector<double>& get_strategy(UPDATE_RULE rule = UPDATE_RULE::REGRET_MATCHING) {
+        bool predictive = rule == UPDATE_RULE::PREDICTIVE_REGRET_MATCHING_PLUS;
         double sum = 0.0;
 
         for (int a = 0; a < num_actions; a++) {
-            strategy[a] = regret_sum[a] > 0 ? regret_sum[a] : 0;
+            double regret = predictive ? regret_sum[a] + prediction[a] : regret_sum[a];
+            strategy[a] = regret > 0 ? regret : 0;
             sum += strategy[a];
         }
 
@@ -37,13 +54,37 @@ class Player {
 
         return strategy;
     }
+
+    void update(const vector<double>& utility, UPDATE_RULE rule) {
+        double value = 0;
+        for (int a = 0; a < num_actions; a++) value += strategy[a] * utility[a];
+
+        for (int a = 0; a < num_actions; a++) {
+            double regret = utility[a] - value;
+            regret_sum[a] += regret;
+            if (rule != UPDATE_RULE::REGRET_MATCHING && regret_sum[a] < 0) regret_sum[a] = 0;
+            if (rule == UPDATE_RULE::PREDICTIVE_REGRET_MATCHING_PLUS) prediction[a] = regret;
+        }
+    }
+
+    void add_action() {
+        regret_sum.push_back(0.0);
+        strategy.push_back(0.0);
+        prediction.push_back(0.0);
+        num_actions++;
+    }
 };
 
 class ColonelBlotto {
    private:
-    mt19937 generator;
+    Philox generator;
+    enum class STREAM : uint32_t { PLAYER1_ACTION = 0, PLAYER2_ACTION, PLAYER1_UPDATED_ACTION };
     vector<vector<int>> all_actions;
     int num_actions;
+    int num_battlefields, num_soldiers;
+    // A mapped solution of another game that seeds every train() call, counted as warm_weight iterations.
+    vector<double> warm_strategy;
+    double warm_weight = 0;
 
     vector<vector<int>> get_available_actions(int n, int s) {
         vector<vector<int>> all_actions;
@@ -66,28 +107,49 @@ class ColonelBlotto {
         return all_actions;
     }
 
-    int get_action(const vector<double>& strategy) {
-        discrete_distribution<> distribution(strategy.begin(), strategy.end());
-        return distribution(generator);
+    int get_action(const vector<double>& strategy, uint64_t iteration, STREAM stream) {
+        double sum = accumulate(strategy.begin(), strategy.end(), 0.0);
+        double r = generator.uniform(iteration, (uint32_t)stream, 0) * sum;
+        int action = 0;
+
+        for (int a = 0; a < num_actions; a++) {
+            if (strategy[a] <= 0) continue;
+            action = a;
+            if (r < strategy[a]) break;
+            r -= strategy[a];
+        }
+
+        return action;
+    }
+
+    int score(int action, int opponent_action) const {
+        int score = 0;
+
+        for (int i = 0; i < all_actions[action].size(); i++) {
+            if (all_actions[action][i] > all_actions[opponent_action][i])
+                score++;
+            else if (all_actions[action][i] < all_actions[opponent_action][i])
+                score--;
+        }
+
+        return score;
     }
 
     vector<int> calculate_actions_utility(const int opponent_action) {
         vector<int> utility(num_actions, 0);
 
-        for (int a = 0; a < num_actions; a++) {
-            int score = 0;
+        for (int a = 0; a < num_actions; a++) utility[a] = score(a, opponent_action);
 
-            for (int i = 0; i < all_actions[a].size(); i++) {
-                if (all_actions[a][i] > all_actions[opponent_action][i])
-                    score++;
-                else if (all_actions[a][i] < all_actions[opponent_action][i])
-                    score--;
-            }
+        return utility;
+    }
 
-            utility[a] = score;
+    void calculate_expected_utility(const vector<double>& opponent_strategy, vector<double>& utility) const {
+        for (int a = 0; a < num_actions; a++) {
+            utility[a] = 0;
+            for (int b = 0; b < num_actions; b++) {
+                if (opponent_strategy[b] > 0) utility[a] += opponent_strategy[b] * score(a, b);
+            }
         }
-
-        return utility;
     }
 
     vector<double> get_average_strategy(const vector<double>& strategy_sum) {
@@ -98,46 +160,356 @@ class ColonelBlotto {
     }
 
    public:
-    ColonelBlotto(int n, int s) : generator(0) {
+    ColonelBlotto(int n, int s) : generator(0), num_battlefields(n), num_soldiers(s) {
         all_actions = get_available_actions(n, s);
         num_actions = all_actions.size();
     }
 
-    vector<double> train(int iterations) {
+    // Seeds every following train() call as if weight iterations had played a strategy over source_actions, mapped
+    // onto this game. Without a mapping, each source allocation spreads over the ways of adding the missing soldiers.
+    bool warm_start(const vector<vector<int>>& source_actions, const vector<double>& source_strategy, double weight,
+                    const function<vector<vector<int>>(const vector<int>&)>& mapping = nullptr) {
+        map<vector<int>, int> index;
+        for (int a = 0; a < num_actions; a++) index[all_actions[a]] = a;
+
+        vector<double> mapped(num_actions, 0.0);
+        for (size_t k = 0; k < source_actions.size(); k++) {
+            if (source_strategy[k] <= 0) continue;
+
+            vector<vector<int>> targets;
+            if (mapping) {
+                targets = mapping(source_actions[k]);
+            } else {
+                int source_soldiers = accumulate(source_actions[k].begin(), source_actions[k].end(), 0);
+                if ((int)source_actions[k].size() != num_battlefields || source_soldiers > num_soldiers) {
+                    cerr << "Error: Cannot map an allocation of " << source_soldiers << " soldiers over "
+                         << source_actions[k].size() << " battlefields without a mapping." << endl;
+                    return false;
+                }
+
+                for (auto extra : get_available_actions(num_battlefields, num_soldiers - source_soldiers)) {
+                    for (int i = 0; i < num_battlefields; i++) extra[i] += source_actions[k][i];
+                    targets.push_back(extra);
+                }
+            }
+
+            for (const auto& target : targets) {
+                auto it = index.find(target);
+                if (it == index.end()) {
+                    cerr << "Error: The mapping returned an allocation that is not an action of this game." << endl;
+                    return false;
+                }
+
+                mapped[it->second] += source_strategy[k] / targets.size();
+            }
+        }
+
+        double sum = accumulate(mapped.begin(), mapped.end(), 0.0);
+        if (sum <= 0) {
+            cerr << "Error: The mapped strategy is empty." << endl;
+            return false;
+        }
+
+        for (double& p : mapped) p /= sum;
+        warm_strategy = mapped;
+        warm_weight = weight;
+        return true;
+    }
+
+    // The update rules and flags work as in section-2-5.cpp.
+    vector<double> train(int iterations, UPDATE_RULE rule = UPDATE_RULE::REGRET_MATCHING, bool alternating = false,
+                         bool last_iterate = false) {
         Player player1(num_actions);
         Player player2(num_actions);
         vector<double> strategy_sum(num_actions, 0.0);
+        vector<double> u1(num_actions), u2(num_actions);
 
-        for (int i = 0; i < iterations; i++) {
-            auto strategy1 = player1.get_strategy();
-            auto strategy2 = player2.get_strategy();
+        // The game is symmetric, so both players start from the same regrets.
+        if (warm_weight > 0) {
+            calculate_expected_utility(warm_strategy, u1);
+            double value = inner_product(warm_strategy.begin(), warm_strategy.end(), u1.begin(), 0.0);
+
+            for (int a = 0; a < num_actions; a++) {
+                double regret = warm_weight * (u1[a] - value);
+                if (rule != UPDATE_RULE::REGRET_MATCHING && regret < 0) regret = 0;
+                player1.regret_sum[a] = player2.regret_sum[a] = regret;
+                strategy_sum[a] = warm_weight * warm_strategy[a];
+            }
+        }
 
-            for (int a = 0; a < num_actions; a++) strategy_sum[a] += strategy1[a];
+        for (int i = 0; i < iterations; i++) {
+            const auto& strategy1 = player1.get_strategy(rule);
+            const auto& strategy2 = player2.get_strategy(rule);
+            double weight = rule == UPDATE_RULE::REGRET_MATCHING ? 1.0 : i + 1.0;
 
-            int action1 = get_action(strategy1);
-            int action2 = get_action(strategy2);
+            for (int a = 0; a < num_actions; a++) strategy_sum[a] += weight * strategy1[a];
 
-            vector<int> u1 = calculate_actions_utility(action2);
-            vector<int> u2 = calculate_actions_utility(action1);
+            if (rule != UPDATE_RULE::REGRET_MATCHING) {
+                calculate_expected_utility(strategy2, u1);
+                if (!alternating) calculate_expected_utility(strategy1, u2);
+                player1.update(u1, rule);
 
-            for (int a = 0; a < num_actions; a++) {
-                player1.regret_sum[a] += u1[a] - u1[action1];
-                player2.regret_sum[a] += u2[a] - u2[action2];
+                if (alternating) calculate_expected_utility(player1.get_strategy(rule), u2);
+                player2.update(u2, rule);
+                continue;
             }
+
+            int action1 = get_action(strategy1, i, STREAM::PLAYER1_ACTION);
+            int action2 = get_action(strategy2, i, STREAM::PLAYER2_ACTION);
+
+            vector<int> sampled_u1 = calculate_actions_utility(action2);
+            for (int a = 0; a < num_actions; a++) player1.regret_sum[a] += sampled_u1[a] - sampled_u1[action1];
+
+            if (alternating) action1 = get_action(player1.get_strategy(rule), i, STREAM::PLAYER1_UPDATED_ACTION);
+            vector<int> sampled_u2 = calculate_actions_utility(action1);
+            for (int a = 0; a < num_actions; a++) player2.regret_sum[a] += sampled_u2[a] - sampled_u2[action2];
         }
 
+        if (last_iterate) return player1.get_strategy(rule);
         return get_average_strategy(strategy_sum);
     }
 
     const vector<vector<int>>& get_all_actions() const { return all_actions; }
 };
 
-int main() {
+// Double-oracle solver for Colonel Blotto: regret matching over small active sets of allocations, grown with best
+// responses until neither player can improve.
+class ColonelBlottoDoubleOracle {
+   private:
+    int num_battlefields;
+    int num_soldiers;
+    array<vector<vector<int>>, 2> active_actions;
+    array<set<vector<int>>, 2> is_active;
+    array<Player, 2> players{Player(0), Player(0)};
+    array<vector<double>, 2> strategy_sums;
+    array<vector<double>, 2> average_strategies;
+    // payoff[i][j] is player 1's utility of active_actions[0][i] against active_actions[1][j].
+    vector<vector<double>> payoff;
+    int rounds = 0;
+    bool converged = false;
+
+    int score(const vector<int>& action, const vector<int>& opponent_action) const {
+        int score = 0;
+
+        for (int i = 0; i < num_battlefields; i++) {
+            if (action[i] > opponent_action[i])
+                score++;
+            else if (action[i] < opponent_action[i])
+                score--;
+        }
+
+        return score;
+    }
+
+    void add_action(int player, const vector<int>& action) {
+        active_actions[player].push_back(action);
+        is_active[player].insert(action);
+        players[player].add_action();
+        strategy_sums[player].push_back(0.0);
+
+        if (player == 0) {
+            payoff.emplace_back();
+            for (const auto& opponent_action : active_actions[1]) {
+                payoff.back().push_back(score(action, opponent_action));
+            }
+        } else {
+            for (size_t i = 0; i < active_actions[0].size(); i++) {
+                payoff[i].push_back(score(active_actions[0][i], action));
+            }
+        }
+    }
+
+    // Best response over all allocations to a mixed strategy, by dynamic programming over the battlefields.
+    pair<vector<int>, double> best_response(int player) const {
+        const auto& opponent_actions = active_actions[1 - player];
+        const auto& opponent_strategy = average_strategies[1 - player];
+
+        vector<vector<double>> gain(num_battlefields, vector<double>(num_soldiers + 1, 0.0));
+        for (int i = 0; i < num_battlefields; i++) {
+            vector<double> probability(num_soldiers + 1, 0.0);
+            for (size_t k = 0; k < opponent_actions.size(); k++) {
+                probability[opponent_actions[k][i]] += opponent_strategy[k];
+            }
+
+            double below = 0, above = 1;
+            for (int x = 0; x <= num_soldiers; x++) {
+                above -= probability[x];
+                gain[i][x] = below - above;
+                below += probability[x];
+            }
+        }
+
+        vector<vector<double>> best(num_battlefields, vector<double>(num_soldiers + 1, 0.0));
+        vector<vector<int>> choice(num_battlefields, vector<int>(num_soldiers + 1, 0));
+        for (int r = 0; r <= num_soldiers; r++) {
+            best[num_battlefields - 1][r] = gain[num_battlefields - 1][r];
+            choice[num_battlefields - 1][r] = r;
+        }
+
+        for (int i = num_battlefields - 2; i >= 0; i--) {
+            for (int r = 0; r <= num_soldiers; r++) {
+                best[i][r] = -numeric_limits<double>::infinity();
+                for (int x = 0; x <= r; x++) {
+                    double value = gain[i][x] + best[i + 1][r - x];
+                    if (value > best[i][r]) {
+                        best[i][r] = value;
+                        choice[i][r] = x;
+                    }
+                }
+            }
+        }
+
+        vector<int> action(num_battlefields);
+        for (int i = 0, r = num_soldiers; i < num_battlefields; i++) {
+            action[i] = choice[i][r];
+            r -= action[i];
+        }
+
+        return {action, best[0][num_soldiers]};
+    }
+
+    // Regrets carry over between rounds, but the averages restart so they never mix in an earlier support.
+    void solve_restricted_game(double target_gap) {
+        const UPDATE_RULE rule = UPDATE_RULE::REGRET_MATCHING_PLUS;
+        const int GAP_CHECK_INTERVAL = 10;
+        int num_actions1 = active_actions[0].size(), num_actions2 = active_actions[1].size();
+        vector<double> u1(num_actions1), u2(num_actions2);
+        for (vector<double>& strategy_sum : strategy_sums) fill(strategy_sum.begin(), strategy_sum.end(), 0.0);
+
+        for (int t = 1;; t++) {
+            const auto& strategy2 = players[1].get_strategy(rule);
+            for (int i = 0; i < num_actions1; i++) {
+                u1[i] = inner_product(payoff[i].begin(), payoff[i].end(), strategy2.begin(), 0.0);
+            }
+            for (int j = 0; j < num_actions2; j++) strategy_sums[1][j] += t * strategy2[j];
+
+            const auto& strategy1 = players[0].get_strategy(rule);
+            for (int i = 0; i < num_actions1; i++) strategy_sums[0][i] += t * strategy1[i];
+            players[0].update(u1, rule);
+
+            const auto& updated1 = players[0].get_strategy(rule);
+            fill(u2.begin(), u2.end(), 0.0);
+            for (int i = 0; i < num_actions1; i++) {
+                for (int j = 0; j < num_actions2; j++) u2[j] -= payoff[i][j] * updated1[i];
+            }
+            players[1].update(u2, rule);
+
+            if (t % GAP_CHECK_INTERVAL != 0) continue;
+
+            for (int player = 0; player < 2; player++) {
+                double sum = accumulate(strategy_sums[player].begin(), strategy_sums[player].end(), 0.0);
+                average_strategies[player] = strategy_sums[player];
+                for (double& s : average_strategies[player]) s /= sum;
+            }
+            if (restricted_gap() <= target_gap) return;
+        }
+    }
+
+    double restricted_gap() const {
+        double best1 = -numeric_limits<double>::infinity(), worst2 = numeric_limits<double>::infinity();
+
+        for (size_t i = 0; i < active_actions[0].size(); i++) {
+            best1 = max(best1, inner_product(payoff[i].begin(), payoff[i].end(), average_strategies[1].begin(), 0.0));
+        }
+        for (size_t j = 0; j < active_actions[1].size(); j++) {
+            double value = 0;
+            for (size_t i = 0; i < active_actions[0].size(); i++) value += average_strategies[0][i] * payoff[i][j];
+            worst2 = min(worst2, value);
+        }
+
+        return best1 - worst2;
+    }
+
+    double restricted_value() const {
+        double value = 0;
+
+        for (size_t i = 0; i < active_actions[0].size(); i++)
+            for (size_t j = 0; j < active_actions[1].size(); j++)
+                value += average_strategies[0][i] * payoff[i][j] * average_strategies[1][j];
+
+        return value;
+    }
+
+   public:
+    ColonelBlottoDoubleOracle(int n, int s) : num_battlefields(n), num_soldiers(s) {
+        vector<int> even(n, s / n);
+        for (int i = 0; i < s % n; i++) even[i]++;
+
+        add_action(0, even);
+        add_action(1, even);
+    }
+
+    // Returns the exploitability of the final strategy profile; has_converged tells whether it is within epsilon.
+    double train(double epsilon, int max_rounds) {
+        double exploitability = 0;
+        converged = false;
+
+        for (int round = 0; round < max_rounds; round++) {
+            solve_restricted_game(epsilon / 2);
+            rounds++;
+
+            double value = restricted_value();
+            auto [response1, value1] = best_response(0);
+            auto [response2, value2] = best_response(1);
+            exploitability = (value1 + value2) / 2;
+
+            if (value1 <= value + epsilon && value2 <= -value + epsilon) {
+                converged = true;
+                break;
+            }
+
+            if (!is_active[0].count(response1)) add_action(0, response1);
+            if (!is_active[1].count(response2)) add_action(1, response2);
+        }
+
+        return exploitability;
+    }
+
+    bool has_converged() const { return converged; }
+
+    int get_rounds() const { return rounds; }
+
+    const vector<vector<int>>& get_active_actions(int player) const { return active_actions[player]; }
+
+    const vector<double>& get_average_strategy(int player) const { return average_strategies[player]; }
+};
+
+bool parse_arguments(int argc, char* argv[], UPDATE_RULE& rule, bool& alternating, bool& last_iterate) {
+    rule = UPDATE_RULE::REGRET_MATCHING;
+    alternating = last_iterate = false;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (i == 1 && arg == "rm") {
+            rule = UPDATE_RULE::REGRET_MATCHING;
+        } else if (i == 1 && arg == "rm+") {
+            rule = UPDATE_RULE::REGRET_MATCHING_PLUS;
+        } else if (i == 1 && arg == "prm+") {
+            rule = UPDATE_RULE::PREDICTIVE_REGRET_MATCHING_PLUS;
+        } else if (arg == "--alternating") {
+            alternating = true;
+        } else if (arg == "--last-iterate") {
+            last_iterate = true;
+        } else {
+            cerr << "Error: Unknown argument " << arg << "." << endl;
+            cerr << "Usage: section-2-6 [rm|rm+|prm+] [--alternating] [--last-iterate]" << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    UPDATE_RULE rule;
+    bool alternating, last_iterate;
+    if (!parse_arguments(argc, argv, rule, alternating, last_iterate)) return 1;
+
     const int num_battlefields = 3;
     const int num_soldiers = 5;
 
     ColonelBlotto solver = ColonelBlotto(num_battlefields, num_soldiers);
-    auto result = solver.train(1'000'000);
+    auto result = solver.train(1'000'000, rule, alternating, last_iterate);
 
     const auto& actions = solver.get_all_actions();
 
@@ -151,5 +523,35 @@ int main() {
         cout << "): " << result[i] * 100 << "%" << endl;
     }
 
+    const int large_num_battlefields = 10;
+    const int large_num_soldiers = 100;
+
+    const double epsilon = 0.05;
+    ColonelBlottoDoubleOracle oracle = ColonelBlottoDoubleOracle(large_num_battlefields, large_num_soldiers);
+    double exploitability = oracle.train(epsilon, 1'000);
+
+    const auto& active_actions = oracle.get_active_actions(0);
+    const auto& strategy = oracle.get_average_strategy(0);
+
+    cout << endl;
+    if (oracle.has_converged()) {
+        cout << "Converged to within " << epsilon << " after " << oracle.get_rounds() << " rounds." << endl;
+    } else {
+        cout << "Not converged: stopped after " << oracle.get_rounds() << " rounds, " << exploitability - epsilon
+             << " above epsilon " << epsilon << "." << endl;
+    }
+    cout << "Exploitability: " << setprecision(4) << exploitability << setprecision(2)
+         << ", support size: " << active_actions.size() << endl;
+    for (size_t i = 0; i < active_actions.size(); i++) {
+        if (strategy[i] < 0.01) continue;
+
+        cout << "(";
+        for (size_t j = 0; j < active_actions[i].size(); j++) {
+            cout << active_actions[i][j];
+            if (j + 1 < active_actions[i].size()) cout << ", ";
+        }
+        cout << "): " << strategy[i] * 100 << "%" << endl;
+    }
+
     return 0;
 }
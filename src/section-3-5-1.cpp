@@ -1,243 +1,91 @@
 // Section 3.5 (1)
 // Two-player Counterfactual Regret Minimization (CFR) with chance sampling for the last round of Dudo.
 // Implemented according to authors' recommendations.
+// Generalized to dice with any number of sides and several dice per player; run with --benchmark to sweep both.
+// Usage: section-3-5-1 [sides] [dice per player] [checkpoint file] [--resume]
 // Exercise from "An Introduction to Counterfactual Regret Minimization" by Todd W. Neller and Marc Lanctot
 
 #include <algorithm>
-#include <fstream>
+#include <chrono>
+#include <iomanip>
 #include <iostream>
-#include <random>
 #include <string>
-#include <unordered_map>
+#include <thread>
 #include <vector>
 
-using namespace std;
-
-const int NUM_SIDES = 6, NUM_ACTIONS = (2 * NUM_SIDES) + 1, DUDO = NUM_ACTIONS - 1;
-const int CLAIM_NUM[] = {1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2};
-const int CLAIM_RANK[] = {2, 3, 4, 5, 6, 1, 2, 3, 4, 5, 6, 1};
-
-class Node {
-   public:
-    int id;
-    vector<double> regret_sum = vector<double>(NUM_ACTIONS, 0.0), strategy = vector<double>(NUM_ACTIONS, 0.0),
-                   strategy_sum = vector<double>(NUM_ACTIONS, 0.0);
-
-    vector<double> get_strategy(double realization_weight) {
-        double sum = 0.0;
-
-        for (int a = 0; a < NUM_ACTIONS; a++) {
-            strategy[a] = regret_sum[a] > 0 ? regret_sum[a] : 0;
-            sum += strategy[a];
-        }
-
-        for (int a = 0; a < NUM_ACTIONS; a++) {
-            if (sum > 0)
-                strategy[a] /= sum;
-            else
-                strategy[a] = 1.0 / NUM_ACTIONS;
-
-            strategy_sum[a] += realization_weight * strategy[a];
-        }
-
-        return strategy;
-    }
+#include "section-3-5-1.h"
 
-    vector<double> get_average_strategy(const vector<double>& strategy_sum) {
-        vector<double> avg(NUM_ACTIONS, 0.0);
-        double sum = accumulate(strategy_sum.begin(), strategy_sum.end(), 0.0);
+using namespace std;
+using bitset_dudo::DudoTrainer;
 
-        for (int a = 0; a < NUM_ACTIONS; a++) {
-            avg[a] = (sum > 0) ? strategy_sum[a] / sum : 1.0 / NUM_ACTIONS;
-        }
+double time_visits(DudoTrainer& solver, int batch_size, int& total_iterations) {
+    total_iterations = 0;
+    double elapsed = 0;
+    auto start = chrono::steady_clock::now();
 
-        return avg;
+    for (int iterations = 1; elapsed < 1.0; iterations *= 2) {
+        solver.train(iterations, false, batch_size);
+        total_iterations += iterations;
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
     }
-};
-
-class DudoTrainer {
-   private:
-    mt19937 generator{0};
-    unordered_map<int, unique_ptr<Node>> node_map = unordered_map<int, unique_ptr<Node>>();
-
-    string claim_history_to_string(const vector<bool>& is_claimed) {
-        string str = "";
-        for (int a = 0; a < NUM_ACTIONS; a++)
-            if (is_claimed[a]) {
-                if (str.length() > 0) str.append(",");
 
-                str.append(to_string(CLAIM_NUM[a]));
-                str.append("*");
-                str.append(to_string(CLAIM_RANK[a]));
-            }
-
-        return str;
-    }
+    return elapsed * 1e9 / solver.get_node_visits();
+}
 
-    int get_infoset_key(int player_roll, const vector<bool>& is_claimed) {
-        int infoset_num = player_roll;
+// Sweeps the number of sides and dice, as the benchmark of section-3-4.cpp sweeps the deck size.
+void benchmark() {
+    const int batch_size = 16;
 
-        for (int a = NUM_ACTIONS - 2; a >= 0; a--) {
-            infoset_num = 2 * infoset_num + (is_claimed[a] ? 1 : 0);
-        }
+    cout << setw(6) << "Sides" << setw(6) << "Dice" << setw(12) << "Infosets" << setw(12) << "Iterations" << setw(12)
+         << "ns/visit" << setw(12) << "batch 1" << setw(12) << "batch " + to_string(batch_size) << setw(10)
+         << "speedup" << endl;
 
-        return infoset_num;
-    }
+    const vector<pair<int, int>> configurations = {{2, 1}, {3, 1}, {4, 1}, {5, 1}, {6, 1}, {2, 2}, {3, 2}, {4, 2}};
 
-    int count_matches(const vector<int>& dice, int rank) {
-        int count = 0;
+    for (auto [num_sides, dice_per_player] : configurations) {
+        if (!DudoTrainer::check_game(num_sides, dice_per_player)) continue;
 
-        for (int d : dice) {
-            if (d == rank || d == 1) count++;
-        }
+        DudoTrainer solver = DudoTrainer(num_sides, dice_per_player);
+        DudoTrainer single_solver = DudoTrainer(num_sides, dice_per_player);
+        DudoTrainer batched_solver = DudoTrainer(num_sides, dice_per_player);
+        int total_iterations, single_iterations, batched_iterations;
+        double recursive_time = time_visits(solver, 0, total_iterations);
+        double single_time = time_visits(single_solver, 1, single_iterations);
+        double batched_time = time_visits(batched_solver, batch_size, batched_iterations);
 
-        return count;
+        cout << setw(6) << num_sides << setw(6) << dice_per_player << setw(12) << solver.get_num_infosets() << setw(12)
+             << total_iterations << setw(12) << fixed << setprecision(1) << recursive_time << setw(12) << single_time
+             << setw(12) << batched_time << setw(10) << setprecision(2) << single_time / batched_time << endl;
     }
+}
 
-    void roll(vector<int>& dice) {
-        uniform_int_distribution<> dist(1, 6);
-
-        for (int& die : dice) {
-            die = dist(generator);
-        }
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "--benchmark") {
+        benchmark();
+        return 0;
     }
 
-    double cfr(vector<int> dice, vector<bool>& is_claimed, int last_action, int turn, double p0, double p1) {
-        int player = turn % 2;
-
-        if (is_claimed[DUDO]) {
-            int challenged_claim = -1;
-            for (int a = DUDO - 1; a >= 0; a--) {
-                if (is_claimed[a]) {
-                    challenged_claim = a;
-                    break;
-                }
-            }
-
-            int claim_num = CLAIM_NUM[challenged_claim];
-            int claim_rank = CLAIM_RANK[challenged_claim];
-            int count = count_matches(dice, claim_rank);
-            bool claimant_wins = (count >= claim_num);
-
-            int claimant = turn % 2;
-
-            if (claimant_wins)
-                return (claimant == 0 ? 1.0 : -1.0);
-            else
-                return (claimant == 0 ? -1.0 : 1.0);
-        }
-
-        int key = get_infoset_key(dice[player], is_claimed);
-        auto& node = node_map.try_emplace(key, make_unique<Node>()).first->second;
-        node->id = key;
-
-        vector<double> strategy = node->get_strategy(player == 0 ? p0 : p1);
-        vector<double> utility = vector<double>(NUM_ACTIONS);
-        double node_utility = 0;
-
-        for (int a = 0; a < NUM_ACTIONS; a++) {
-            if (a == DUDO) {
-                if (turn == 0) continue;
-            } else {
-                if (a <= last_action && turn > 0) continue;
-            }
-
-            is_claimed[a] = true;
-
-            utility[a] = cfr(dice, is_claimed, a, turn + 1, player == 0 ? p0 * strategy[a] : p0,
-                             player == 1 ? p1 * strategy[a] : p1);
-
-            is_claimed[a] = false;
-
-            node_utility += strategy[a] * utility[a];
-        }
-
-        for (int a = 0; a < NUM_ACTIONS; a++) {
-            if (a == DUDO && turn == 0) continue;
-            if (a != DUDO && a <= last_action && turn > 0) continue;
-
-            double regret = (player == 0) ? (utility[a] - node_utility) : (node_utility - utility[a]);
-            node->regret_sum[a] += (player == 0 ? p1 : p0) * regret;
-        }
-
-        return node_utility;
+    if (argc > 1 && string(argv[1]) == "--exact") {
+        int num_threads = argc > 2 ? stoi(argv[2]) : max(1u, thread::hardware_concurrency());
+        DudoTrainer solver = DudoTrainer();
+        auto start = chrono::steady_clock::now();
+        cout << "Average game value: " << solver.train_exact(1'000, num_threads) << endl;
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        cout << "1000 exact iterations on " << num_threads << " threads in " << elapsed.count() << " s" << endl;
+        solver.save_strategies("strategies.txt");
+        return 0;
     }
 
-   public:
-    void train(int iterations) {
-        vector<int> dice{0, 0};
-        vector<bool> is_claimed(NUM_ACTIONS, false);
-        double total_utility = 0;
+    int num_sides = argc > 1 ? stoi(argv[1]) : 6;
+    int dice_per_player = argc > 2 ? stoi(argv[2]) : 1;
+    if (!DudoTrainer::check_game(num_sides, dice_per_player)) return 1;
 
-        for (int i = 0; i < iterations; i++) {
-            roll(dice);
-            fill(is_claimed.begin(), is_claimed.end(), false);
-            total_utility += cfr(dice, is_claimed, -1, 0, 1.0, 1.0);
-        }
-
-        cout << "Average game value: " << total_utility / iterations << endl;
-    }
-
-    void save_strategies(const string& filename) {
-        ofstream outfile(filename);
-
-        if (!outfile.is_open()) {
-            cerr << "Error: Could not open file " << filename << " for writing." << endl;
-            return;
-        }
-
-        vector<int> keys;
-        keys.reserve(node_map.size());
-        for (auto& pair : node_map) {
-            keys.push_back(pair.first);
-        }
-        sort(keys.begin(), keys.end());
-
-        for (int key : keys) {
-            Node* node = node_map[key].get();
-            vector<double> avg_strategy = node->get_average_strategy(node->strategy_sum);
-
-            int shift = NUM_ACTIONS - 1;
-            int roll = key >> shift;
-
-            vector<bool> is_claimed(NUM_ACTIONS, false);
-            for (int a = 0; a < shift; a++) {
-                if ((key >> a) & 1) {
-                    is_claimed[a] = true;
-                }
-            }
-
-            string history = claim_history_to_string(is_claimed);
-            if (history.empty()) history = "(Start)";
-
-            outfile << "Roll: " << roll << " | History: " << history << "\n";
-            outfile << "    Strategy: ";
-
-            bool first = true;
-            for (int a = 0; a < NUM_ACTIONS; a++) {
-                if (avg_strategy[a] > 0.001) {
-                    if (!first) outfile << ", ";
-
-                    if (a == DUDO) {
-                        outfile << "Dudo";
-                    } else {
-                        outfile << CLAIM_NUM[a] << "x" << CLAIM_RANK[a];
-                    }
-
-                    outfile << ": " << fixed << setprecision(2) << avg_strategy[a] * 100 << '%';
-                    first = false;
-                }
-            }
-            outfile << "\n" << endl;
-        }
-
-        outfile.close();
-    }
-};
+    DudoTrainer solver = DudoTrainer(num_sides, dice_per_player);
+    if (argc > 4 && string(argv[4]) == "--resume" && !solver.load_checkpoint(argv[3])) return 1;
+    if (argc > 3) solver.enable_checkpoints(argv[3], 0, 600);
 
-int main() {
-    DudoTrainer solver = DudoTrainer();
-    solver.train(1'000'000);
+    int iterations = 1'000'000 - solver.get_completed_iterations();
+    if (iterations > 0) cout << "Average game value: " << solver.train(iterations) << endl;
     solver.save_strategies("strategies.txt");
 
     return 0;
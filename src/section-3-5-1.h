@@ -0,0 +1,851 @@
+// Section 3.5 (1) trainer: chance-sampled CFR for the last round of Dudo, implemented according to authors'
+// recommendations. Used by section-3-5-1.cpp and dudo-equivalence.cpp.
+
+#ifndef SRC_SECTION_3_5_1_H_
+#define SRC_SECTION_3_5_1_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "checkpointer.h"
+#include "dudo.h"
+#include "philox.h"
+
+namespace bitset_dudo {
+
+using namespace std;
+
+class Node {
+   public:
+    int id;
+    int index = 0, checkpoint_epoch = 0;
+    int num_actions;
+    vector<double> regret_sum, strategy, strategy_sum;
+
+    Node(int num_actions)
+        : num_actions(num_actions),
+          regret_sum(num_actions, 0.0),
+          strategy(num_actions, 0.0),
+          strategy_sum(num_actions, 0.0) {}
+
+    // Writes the current strategy over actions first_action..last_action to out without modifying the node.
+    void compute_strategy(double* out, int first_action, int last_action) const {
+        double sum = 0.0;
+
+        for (int a = 0; a < num_actions; a++) {
+            bool allowed = a >= first_action && a <= last_action;
+            out[a] = allowed && regret_sum[a] > 0 ? regret_sum[a] : 0;
+            sum += out[a];
+        }
+
+        for (int a = first_action; a <= last_action; a++) {
+            if (sum > 0)
+                out[a] /= sum;
+            else
+                out[a] = 1.0 / (last_action - first_action + 1);
+        }
+    }
+
+    void update_strategy(double realization_weight) {
+        compute_strategy(strategy.data(), 0, num_actions - 1);
+
+        for (int a = 0; a < num_actions; a++) {
+            if (realization_weight > 0) strategy_sum[a] += realization_weight * strategy[a];
+        }
+    }
+
+    vector<double> get_strategy(double realization_weight) {
+        update_strategy(realization_weight);
+        return strategy;
+    }
+
+    vector<double> get_average_strategy(const vector<double>& strategy_sum) {
+        vector<double> avg(num_actions, 0.0);
+        double sum = accumulate(strategy_sum.begin(), strategy_sum.end(), 0.0);
+
+        for (int a = 0; a < num_actions; a++) {
+            avg[a] = (sum > 0) ? strategy_sum[a] / sum : 1.0 / num_actions;
+        }
+
+        return avg;
+    }
+};
+
+// Fork-join pool with work stealing: workers pop their own newest tasks and steal the oldest from the others.
+class WorkStealingPool {
+   public:
+    struct Group {
+        atomic<int> pending{0};
+    };
+
+   private:
+    struct Task {
+        function<void()> run;
+        Group* group;
+    };
+
+    struct Worker {
+        mutex lock;
+        deque<Task> tasks;
+    };
+
+    vector<unique_ptr<Worker>> workers;
+    vector<thread> threads;
+    atomic<int> queued{0};
+    bool stopping = false;
+    mutex idle_lock;
+    condition_variable work_available;
+
+    static int& current_worker() {
+        static thread_local int worker = -1;
+        return worker;
+    }
+
+    bool pop(int w, Task& task) {
+        Worker& worker = *workers[w];
+        lock_guard<mutex> guard(worker.lock);
+        if (worker.tasks.empty()) return false;
+
+        task = move(worker.tasks.back());
+        worker.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(int w, Task& task) {
+        for (size_t k = 1; k < workers.size(); k++) {
+            Worker& victim = *workers[(w + k) % workers.size()];
+            lock_guard<mutex> guard(victim.lock);
+            if (victim.tasks.empty()) continue;
+
+            task = move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+
+        return false;
+    }
+
+    bool run_one(int w) {
+        Task task;
+        if (!pop(w, task) && !steal(w, task)) return false;
+
+        queued--;
+        task.run();
+        task.group->pending--;
+        return true;
+    }
+
+    void work(int w) {
+        current_worker() = w;
+
+        while (true) {
+            if (run_one(w)) continue;
+
+            unique_lock<mutex> guard(idle_lock);
+            work_available.wait(guard, [&] { return stopping || queued > 0; });
+            if (stopping) return;
+        }
+    }
+
+   public:
+    WorkStealingPool(int num_workers) {
+        for (int w = 0; w < max(1, num_workers); w++) workers.push_back(make_unique<Worker>());
+        for (int w = 1; w < (int)workers.size(); w++) threads.emplace_back(&WorkStealingPool::work, this, w);
+    }
+
+    ~WorkStealingPool() {
+        {
+            lock_guard<mutex> guard(idle_lock);
+            stopping = true;
+        }
+        work_available.notify_all();
+        for (thread& t : threads) t.join();
+    }
+
+    int get_num_workers() const { return workers.size(); }
+
+    // The calling thread's worker number, or -1 outside the pool.
+    static int get_worker() { return current_worker(); }
+
+    // Runs root on the calling thread as worker 0. Tasks may only be spawned from inside root or from other tasks.
+    void run(const function<void()>& root) {
+        current_worker() = 0;
+        root();
+        current_worker() = -1;
+    }
+
+    void spawn(Group& group, function<void()> task) {
+        group.pending++;
+        {
+            Worker& worker = *workers[current_worker()];
+            lock_guard<mutex> guard(worker.lock);
+            worker.tasks.push_back({move(task), &group});
+        }
+
+        {
+            lock_guard<mutex> guard(idle_lock);
+            queued++;
+        }
+        work_available.notify_one();
+    }
+
+    // Returns once every task of the group has finished, running queued tasks while it waits.
+    void wait(Group& group) {
+        while (group.pending > 0) {
+            if (!run_one(current_worker())) this_thread::yield();
+        }
+    }
+};
+
+class DudoTrainer : private DudoGame {
+   private:
+    Philox generator{0};
+    unordered_map<int, unique_ptr<Node>> node_map = unordered_map<int, unique_ptr<Node>>();
+    int completed_iterations = 0;
+    long long node_visits = 0;
+    vector<Node*> nodes;
+
+    unique_ptr<Checkpointer<int>> checkpointer;
+
+    // A sampled roll traversed with an explicit stack, staged and prefetched as in section-3-4.cpp.
+    enum class STAGE { FETCH_SLOT, FETCH_NODE, FETCH_DATA };
+    struct Traversal {
+        struct Frame {
+            // Claims made so far as a bit mask, the claim that led here and the next action to explore.
+            int claimed, last_action, turn;
+            double p0, p1;
+            Node* node;
+            int action;
+            double node_utility;
+        };
+
+        vector<int> dice;
+        array<int, 2> roll_codes;
+        int traverser;
+        // One frame per turn, with num_actions strategy and utility entries each.
+        vector<Frame> frames;
+        vector<double> strategies, utilities;
+        int depth, slot;
+        STAGE stage;
+        double value;
+    };
+    vector<Traversal> batch;
+    // Dense infoset index for batched traversal, addressed by infoset key and built lazily.
+    vector<Node*> node_table;
+
+    vector<Deal> deals;
+    unique_ptr<WorkStealingPool> pool;
+    int num_rolls = 0;
+    vector<long long> worker_visits;
+    // Infoset keys leave one bit per claim below the roll code, so no game here has more actions than this.
+    static constexpr int MAX_ACTIONS = 32;
+    // A claim node's child becomes a pool task when at least this many claims remain above it.
+    static constexpr int MIN_TASK_CLAIMS = 7;
+    static constexpr int STRATEGY_NODES_PER_TASK = 1024;
+    // Batched and exact traversal index a table with a slot for every possible infoset key; this caps it at 1 GiB.
+    static constexpr uint64_t MAX_TABLE_SLOTS = uint64_t{1} << 27;
+
+    string claim_history_to_string(const vector<bool>& is_claimed) {
+        string str = "";
+        for (int a = 0; a < num_actions; a++)
+            if (is_claimed[a]) {
+                if (str.length() > 0) str.append(",");
+
+                str.append(to_string(claim_num[a]));
+                str.append("*");
+                str.append(to_string(claim_rank[a]));
+            }
+
+        return str;
+    }
+
+    string roll_code_to_string(int roll_code) {
+        string str = "";
+        for (int d = 0, code = roll_code - 1; d < dice_per_player; d++, code /= num_sides) {
+            if (str.length() > 0) str.append(",");
+
+            str.append(to_string(code % num_sides + 1));
+        }
+
+        return str;
+    }
+
+    int get_infoset_key(int player_roll, const vector<bool>& is_claimed) {
+        int infoset_num = player_roll;
+
+        for (int a = num_actions - 2; a >= 0; a--) {
+            infoset_num = 2 * infoset_num + (is_claimed[a] ? 1 : 0);
+        }
+
+        return infoset_num;
+    }
+
+    Node* get_node(int key) {
+        auto [it, inserted] = node_map.try_emplace(key, nullptr);
+
+        if (inserted) {
+            it->second = make_unique<Node>(num_actions);
+            it->second->id = key;
+            it->second->index = nodes.size();
+            nodes.push_back(it->second.get());
+        }
+
+        return it->second.get();
+    }
+
+    double cfr(vector<int> dice, vector<bool>& is_claimed, int last_action, int turn, double p0, double p1,
+               int traverser) {
+        int player = turn % 2;
+
+        if (is_claimed[dudo]) {
+            int challenged_claim = -1;
+            for (int a = dudo - 1; a >= 0; a--) {
+                if (is_claimed[a]) {
+                    challenged_claim = a;
+                    break;
+                }
+            }
+
+            return get_challenge_utility(dice, challenged_claim, turn % 2);
+        }
+
+        bool alternating = traverser >= 0;
+        if (alternating && (traverser == 0 ? p1 : p0) == 0) return 0;
+
+        int key = get_infoset_key(get_roll_code(dice, player), is_claimed);
+        Node* node = get_node(key);
+        if (checkpointer) checkpointer->preserve(node, &Node::id);
+        node_visits++;
+
+        double realization_weight = alternating && player == traverser ? 0.0 : (player == 0 ? p0 : p1);
+        vector<double> strategy = node->get_strategy(realization_weight);
+        vector<double> utility = vector<double>(num_actions);
+        double node_utility = 0;
+
+        for (int a = 0; a < num_actions; a++) {
+            if (a == dudo) {
+                if (turn == 0) continue;
+            } else {
+                if (a <= last_action && turn > 0) continue;
+            }
+
+            is_claimed[a] = true;
+
+            utility[a] = cfr(dice, is_claimed, a, turn + 1, player == 0 ? p0 * strategy[a] : p0,
+                             player == 1 ? p1 * strategy[a] : p1, traverser);
+
+            is_claimed[a] = false;
+
+            node_utility += strategy[a] * utility[a];
+        }
+
+        if (alternating && player != traverser) return node_utility;
+
+        for (int a = 0; a < num_actions; a++) {
+            if (a == dudo && turn == 0) continue;
+            if (a != dudo && a <= last_action && turn > 0) continue;
+
+            double regret = (player == 0) ? (utility[a] - node_utility) : (node_utility - utility[a]);
+            node->regret_sum[a] += (player == 0 ? p1 : p0) * regret;
+        }
+
+        return node_utility;
+    }
+
+    bool enter(Traversal& t, int claimed, int last_action, int turn, double p0, double p1, double& value) {
+        if (last_action == dudo) {
+            // Claims only ever rise, so the challenged claim is the highest one made.
+            value = get_challenge_utility(t.dice, 31 - __builtin_clz(claimed), turn % 2);
+            return false;
+        }
+
+        if (t.traverser >= 0 && (t.traverser == 0 ? p1 : p0) == 0) {
+            value = 0;
+            return false;
+        }
+
+        Traversal::Frame& frame = t.frames[++t.depth];
+        frame.claimed = claimed;
+        frame.last_action = last_action;
+        frame.turn = turn;
+        frame.p0 = p0;
+        frame.p1 = p1;
+
+        t.slot = (t.roll_codes[turn % 2] << (num_actions - 1)) | claimed;
+        t.stage = STAGE::FETCH_SLOT;
+        __builtin_prefetch(&node_table[t.slot]);
+        return true;
+    }
+
+    bool advance(Traversal& t) {
+        Traversal::Frame* frame = &t.frames[t.depth];
+
+        if (t.stage == STAGE::FETCH_SLOT) {
+            Node*& slot = node_table[t.slot];
+            if (slot == nullptr) slot = get_node(t.slot);
+
+            frame->node = slot;
+            __builtin_prefetch(slot);
+            t.stage = STAGE::FETCH_NODE;
+            return true;
+        }
+
+        if (t.stage == STAGE::FETCH_NODE) {
+            __builtin_prefetch(frame->node->regret_sum.data());
+            __builtin_prefetch(frame->node->strategy.data());
+            __builtin_prefetch(frame->node->strategy_sum.data());
+            t.stage = STAGE::FETCH_DATA;
+            return true;
+        }
+
+        bool alternating = t.traverser >= 0;
+        int player = frame->turn % 2;
+
+        if (checkpointer) checkpointer->preserve(frame->node, &Node::id);
+        node_visits++;
+
+        double realization_weight = alternating && player == t.traverser ? 0.0 : (player == 0 ? frame->p0 : frame->p1);
+        frame->node->update_strategy(realization_weight);
+        copy(frame->node->strategy.begin(), frame->node->strategy.end(), t.strategies.begin() + t.depth * num_actions);
+        frame->action = -1;
+        frame->node_utility = 0;
+
+        double value = 0;
+        while (true) {
+            double* strategy = &t.strategies[t.depth * num_actions];
+            double* utility = &t.utilities[t.depth * num_actions];
+            int first_action = frame->turn == 0 ? 0 : frame->last_action + 1;
+            int last_action = frame->turn == 0 ? dudo - 1 : dudo;
+            int a = frame->action;
+            player = frame->turn % 2;
+
+            if (a >= 0) {
+                utility[a] = value;
+                frame->node_utility += strategy[a] * utility[a];
+            }
+
+            a = a < 0 ? first_action : a + 1;
+            if (a <= last_action) {
+                frame->action = a;
+                int claimed = a == dudo ? frame->claimed : frame->claimed | (1 << a);
+                double p0 = player == 0 ? frame->p0 * strategy[a] : frame->p0;
+                double p1 = player == 1 ? frame->p1 * strategy[a] : frame->p1;
+
+                if (enter(t, claimed, a, frame->turn + 1, p0, p1, value)) return true;
+                continue;
+            }
+
+            if (!alternating || player == t.traverser) {
+                for (a = first_action; a <= last_action; a++) {
+                    double regret = utility[a] - frame->node_utility;
+                    if (player == 1) regret = -regret;
+                    frame->node->regret_sum[a] += (player == 0 ? frame->p1 : frame->p0) * regret;
+                }
+            }
+
+            value = frame->node_utility;
+            if (--t.depth < 0) {
+                t.value = value;
+                return false;
+            }
+            frame = &t.frames[t.depth];
+        }
+    }
+
+    void build_node_table() {
+        if (!node_table.empty()) return;
+
+        int num_roll_codes = 1;
+        for (int d = 0; d < dice_per_player; d++) num_roll_codes *= num_sides;
+        node_table.assign((size_t)(num_roll_codes + 1) << (num_actions - 1), nullptr);
+    }
+
+    double traverse_batch(int first, int count, bool alternating) {
+        build_node_table();
+        if ((int)batch.size() < count) batch.resize(count);
+
+        vector<int> active(count);
+        for (int k = 0; k < count; k++) {
+            Traversal& t = batch[k];
+            t.dice.resize(2 * dice_per_player);
+            t.frames.resize(num_actions);
+            t.strategies.resize(num_actions * num_actions);
+            t.utilities.resize(num_actions * num_actions);
+
+            roll(generator, t.dice, first + k);
+            t.roll_codes = {get_roll_code(t.dice, 0), get_roll_code(t.dice, 1)};
+            t.traverser = alternating ? (first + k) % 2 : -1;
+            t.depth = -1;
+
+            double value;
+            enter(t, 0, -1, 0, 1.0, 1.0, value);
+            active[k] = k;
+        }
+
+        double total_utility = 0;
+        while (!active.empty()) {
+            for (size_t k = 0; k < active.size();) {
+                Traversal& t = batch[active[k]];
+                if (advance(t)) {
+                    k++;
+                    continue;
+                }
+
+                total_utility += t.value;
+                active[k] = active.back();
+                active.pop_back();
+            }
+        }
+
+        return total_utility;
+    }
+
+    // Creates every infoset up front, since nodes cannot be created while workers traverse the table.
+    void prepare_exact_iterations(int num_threads) {
+        if (pool == nullptr || pool->get_num_workers() != max(1, num_threads)) {
+            pool = make_unique<WorkStealingPool>(num_threads);
+        }
+
+        if (deals.empty()) {
+            deals = enumerate_deals();
+            num_rolls = lround(sqrt(deals.size()));
+        }
+
+        build_node_table();
+        for (const Deal& deal : deals) {
+            for (int claimed = 0; claimed < 1 << (num_actions - 1); claimed++) {
+                int key = (deal.roll_codes[0] << (num_actions - 1)) | claimed;
+                if (node_table[key] == nullptr) node_table[key] = get_node(key);
+            }
+        }
+    }
+
+    // Counterpart of cfr for exact iterations, weighting both the regrets and the strategy sums by the deal's chance
+    // probability.
+    double cfr_exact(const Deal& deal, int claimed, int last_action, int turn, double p0, double p1, int traverser) {
+        if (last_action == dudo) return get_challenge_utility(deal.dice, 31 - __builtin_clz(claimed), turn % 2);
+
+        bool alternating = traverser >= 0;
+        if (alternating && (traverser == 0 ? p1 : p0) == 0) return 0;
+
+        int player = turn % 2;
+        int worker = WorkStealingPool::get_worker();
+        Node* node = node_table[(deal.roll_codes[player] << (num_actions - 1)) | claimed];
+        if (checkpointer) checkpointer->preserve(node, &Node::id);
+        worker_visits[worker]++;
+
+        auto [first_action, final_action] = legal_actions(claimed);
+        const vector<double>& strategy = node->strategy;
+        array<double, MAX_ACTIONS> utility;
+
+        double realization_weight = alternating && player == traverser ? 0.0 : (player == 0 ? p0 : p1);
+        if (realization_weight > 0) {
+            for (int a = 0; a < num_actions; a++) {
+                node->strategy_sum[a] += deal.probability * realization_weight * strategy[a];
+            }
+        }
+
+        auto traverse = [&, player](int a) {
+            int next_claimed = a == dudo ? claimed : claimed | (1 << a);
+            utility[a] = cfr_exact(deal, next_claimed, a, turn + 1, player == 0 ? p0 * strategy[a] : p0,
+                                   player == 1 ? p1 * strategy[a] : p1, traverser);
+        };
+
+        if (dudo - first_action - 1 >= MIN_TASK_CLAIMS) {
+            WorkStealingPool::Group children;
+            for (int a = first_action; a <= final_action; a++) {
+                if (dudo - a - 1 >= MIN_TASK_CLAIMS) {
+                    pool->spawn(children, [&traverse, a] { traverse(a); });
+                } else {
+                    traverse(a);
+                }
+            }
+            pool->wait(children);
+        } else {
+            for (int a = first_action; a <= final_action; a++) traverse(a);
+        }
+
+        double node_utility = 0;
+        for (int a = first_action; a <= final_action; a++) node_utility += strategy[a] * utility[a];
+
+        if (alternating && player != traverser) return node_utility;
+
+        for (int a = first_action; a <= final_action; a++) {
+            double regret = (player == 0) ? (utility[a] - node_utility) : (node_utility - utility[a]);
+            node->regret_sum[a] += deal.probability * (player == 0 ? p1 : p0) * regret;
+        }
+
+        return node_utility;
+    }
+
+    // Round k pairs each roll i of player 0 with roll i + k mod num_rolls of player 1, so the deals of a round share
+    // no infoset and run in parallel.
+    double play_exact_deals(int traverser) {
+        worker_visits.assign(pool->get_num_workers(), 0);
+        vector<double> values(deals.size());
+
+        pool->run([&] {
+            for (int round = 0; round < num_rolls; round++) {
+                WorkStealingPool::Group group;
+                for (int roll = 0; roll < num_rolls; roll++) {
+                    size_t d = (size_t)roll * num_rolls + (roll + round) % num_rolls;
+                    pool->spawn(group, [&, d] { values[d] = cfr_exact(deals[d], 0, -1, 0, 1.0, 1.0, traverser); });
+                }
+                pool->wait(group);
+            }
+        });
+
+        for (long long visits : worker_visits) node_visits += visits;
+
+        double value = 0;
+        for (size_t d = 0; d < deals.size(); d++) value += deals[d].probability * values[d];
+        return value;
+    }
+
+    // Unlike cfr, the strategies put no mass on illegal actions, which would drop out of every exact utility.
+    double exact_iteration(int traverser) {
+        pool->run([&] {
+            WorkStealingPool::Group strategies;
+            for (size_t first = 0; first < nodes.size(); first += STRATEGY_NODES_PER_TASK) {
+                pool->spawn(strategies, [&, first] {
+                    size_t last = min(nodes.size(), first + STRATEGY_NODES_PER_TASK);
+                    for (size_t n = first; n < last; n++) {
+                        int claimed = nodes[n]->id & ((1 << (num_actions - 1)) - 1);
+                        auto [first_action, final_action] = legal_actions(claimed);
+                        nodes[n]->compute_strategy(nodes[n]->strategy.data(), first_action, final_action);
+                    }
+                });
+            }
+            pool->wait(strategies);
+        });
+
+        return play_exact_deals(traverser);
+    }
+
+   public:
+    static bool check_game(int num_sides, int dice_per_player) {
+        return DudoGame::check_game(num_sides, dice_per_player, MAX_TABLE_SLOTS);
+    }
+
+    DudoTrainer(int num_sides = 6, int dice_per_player = 1) : DudoGame(num_sides, dice_per_player) {}
+
+    void enable_checkpoints(const string& filename, int every_iterations, double every_seconds) {
+        checkpointer = make_unique<Checkpointer<int>>(filename, num_actions, every_iterations, every_seconds,
+                                                      completed_iterations);
+    }
+
+    bool load_checkpoint(const string& filename) {
+        Checkpointer<int>::Snapshot saved;
+        if (!Checkpointer<int>::read(filename, num_actions, saved)) return false;
+
+        node_map.clear();
+        nodes.clear();
+        node_table.clear();
+        for (size_t k = 0; k < saved.keys.size(); k++) {
+            Node* node = get_node(saved.keys[k]);
+
+            const double* values = &saved.values[k * 2 * num_actions];
+            copy(values, values + num_actions, node->regret_sum.begin());
+            copy(values + num_actions, values + 2 * num_actions, node->strategy_sum.begin());
+        }
+
+        completed_iterations = saved.iteration;
+        return true;
+    }
+
+    // Seeds the tables as if weight exact iterations had played the mapped average strategy of another game's
+    // checkpoint. Actions that action_mapping sends to the same source action share its probability, and actions
+    // mapped to a negative action never play.
+    bool warm_start(const string& filename, int source_sides, int source_dice, double weight,
+                    const function<int(int)>& infoset_mapping, const function<int(int)>& action_mapping) {
+        int source_actions = 2 * source_dice * source_sides + 1;
+        Checkpointer<int>::Snapshot saved;
+        if (!Checkpointer<int>::read(filename, source_actions, saved)) return false;
+
+        unordered_map<int, size_t> source;
+        for (size_t k = 0; k < saved.keys.size(); k++) source[saved.keys[k]] = k;
+
+        node_map.clear();
+        nodes.clear();
+        node_table.clear();
+        prepare_exact_iterations(max(1u, thread::hardware_concurrency()));
+
+        vector<int> source_action(num_actions), shares(source_actions);
+        for (Node* node : nodes) {
+            auto [first_action, final_action] = legal_actions(node->id & ((1 << (num_actions - 1)) - 1));
+            auto it = source.find(infoset_mapping(node->id));
+
+            fill(shares.begin(), shares.end(), 0);
+            for (int a = first_action; a <= final_action; a++) {
+                source_action[a] = it == source.end() ? -1 : action_mapping(a);
+                if (source_action[a] >= 0 && source_action[a] < source_actions) shares[source_action[a]]++;
+            }
+
+            double sum = 0;
+            fill(node->strategy.begin(), node->strategy.end(), 0.0);
+            for (int a = first_action; a <= final_action; a++) {
+                int s = source_action[a];
+                if (s < 0 || s >= source_actions) continue;
+
+                node->strategy[a] = saved.values[(it->second * 2 + 1) * source_actions + s] / shares[s];
+                sum += node->strategy[a];
+            }
+
+            for (int a = first_action; a <= final_action; a++) {
+                node->strategy[a] = sum > 0 ? node->strategy[a] / sum : 1.0 / (final_action - first_action + 1);
+            }
+        }
+
+        play_exact_deals(-1);
+        for (Node* node : nodes) {
+            for (int a = 0; a < num_actions; a++) {
+                node->regret_sum[a] *= weight;
+                node->strategy_sum[a] *= weight;
+            }
+        }
+
+        return true;
+    }
+
+    // With batch_size above zero, that many iterations are traversed together with their infoset lookups interleaved.
+    double train(int iterations, bool alternating = false, int batch_size = 0) {
+        vector<int> dice(2 * dice_per_player, 0);
+        vector<bool> is_claimed(num_actions, false);
+        double total_utility = 0;
+        int end = completed_iterations + iterations;
+
+        for (int i = completed_iterations; i < end;) {
+            if (batch_size > 0) {
+                int count = min(batch_size, end - i);
+                total_utility += traverse_batch(i, count, alternating);
+                i += count;
+            } else {
+                roll(generator, dice, i);
+                fill(is_claimed.begin(), is_claimed.end(), false);
+                total_utility += cfr(dice, is_claimed, -1, 0, 1.0, 1.0, alternating ? i % 2 : -1);
+                i++;
+            }
+
+            if (checkpointer) checkpointer->advance(i, nodes, &Node::id);
+        }
+
+        completed_iterations += iterations;
+        if (checkpointer) checkpointer->take_final(completed_iterations, nodes, &Node::id);
+
+        return total_utility / iterations;
+    }
+
+    // Iterations traverse every roll weighted by its probability instead of sampling one. The result does not depend
+    // on num_threads.
+    double train_exact(int iterations, int num_threads, bool alternating = false) {
+        prepare_exact_iterations(num_threads);
+        double total_utility = 0;
+
+        for (int i = completed_iterations; i < completed_iterations + iterations; i++) {
+            total_utility += exact_iteration(alternating ? i % 2 : -1);
+
+            if (checkpointer) checkpointer->advance(i + 1, nodes, &Node::id);
+        }
+
+        completed_iterations += iterations;
+        if (checkpointer) checkpointer->take_final(completed_iterations, nodes, &Node::id);
+
+        return total_utility / iterations;
+    }
+
+    size_t get_num_infosets() const { return node_map.size(); }
+
+    long long get_node_visits() const { return node_visits; }
+
+    int get_completed_iterations() const { return completed_iterations; }
+
+    vector<int> get_infoset_keys() const {
+        vector<int> keys;
+        keys.reserve(node_map.size());
+        for (const auto& pair : node_map) keys.push_back(pair.first);
+        sort(keys.begin(), keys.end());
+        return keys;
+    }
+
+    vector<double> get_average_strategy(int key) const {
+        auto it = node_map.find(key);
+        if (it == node_map.end()) return {};
+        return it->second->get_average_strategy(it->second->strategy_sum);
+    }
+
+    void save_strategies(const string& filename) {
+        ofstream outfile(filename);
+
+        if (!outfile.is_open()) {
+            cerr << "Error: Could not open file " << filename << " for writing." << endl;
+            return;
+        }
+
+        vector<int> keys;
+        keys.reserve(node_map.size());
+        for (auto& pair : node_map) {
+            keys.push_back(pair.first);
+        }
+        sort(keys.begin(), keys.end());
+
+        for (int key : keys) {
+            Node* node = node_map[key].get();
+            vector<double> avg_strategy = node->get_average_strategy(node->strategy_sum);
+
+            int shift = num_actions - 1;
+            string roll = roll_code_to_string(key >> shift);
+
+            vector<bool> is_claimed(num_actions, false);
+            for (int a = 0; a < shift; a++) {
+                if ((key >> a) & 1) {
+                    is_claimed[a] = true;
+                }
+            }
+
+            string history = claim_history_to_string(is_claimed);
+            if (history.empty()) history = "(Start)";
+
+            outfile << "Roll: " << roll << " | History: " << history << "\n";
+            outfile << "    Strategy: ";
+
+            bool first = true;
+            for (int a = 0; a < num_actions; a++) {
+                if (avg_strategy[a] > 0.001) {
+                    if (!first) outfile << ", ";
+
+                    if (a == dudo) {
+                        outfile << "Dudo";
+                    } else {
+                        outfile << claim_num[a] << "x" << claim_rank[a];
+                    }
+
+                    outfile << ": " << fixed << setprecision(2) << avg_strategy[a] * 100 << '%';
+                    first = false;
+                }
+            }
+            outfile << "\n" << endl;
+        }
+
+        outfile.close();
+    }
+};
+
+}  // namespace bitset_dudo
+
+#endif  // SRC_SECTION_3_5_1_H_
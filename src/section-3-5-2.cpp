@@ -1,176 +1,63 @@
 // Section 3.5 (2)
 // Two-player Counterfactual Regret Minimization (CFR) with chance sampling for the last round of Dudo.
 // Implemented with full history vector passing.
+// Usage: section-3-5-2 [sides] [dice per player] [checkpoint file] [--resume]
+//        section-3-5-2 --benchmark
 // Exercise from "An Introduction to Counterfactual Regret Minimization" by Todd W. Neller and Marc Lanctot
 
-#include <algorithm>
+#include <chrono>
+#include <iomanip>
 #include <iostream>
-#include <random>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
-using namespace std;
-
-const int NUM_SIDES = 6, NUM_ACTIONS = (2 * NUM_SIDES) + 1, DUDO = NUM_ACTIONS - 1;
-const int CLAIM_NUM[] = {1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2};
-const int CLAIM_RANK[] = {2, 3, 4, 5, 6, 1, 2, 3, 4, 5, 6, 1};
-
-class Node {
-   public:
-    int id;
-    vector<double> regret_sum = vector<double>(NUM_ACTIONS, 0.0), strategy = vector<double>(NUM_ACTIONS, 0.0),
-                   strategy_sum = vector<double>(NUM_ACTIONS, 0.0);
-
-    vector<double> get_strategy(double realization_weight) {
-        double sum = 0.0;
-
-        for (int a = 0; a < NUM_ACTIONS; a++) {
-            strategy[a] = regret_sum[a] > 0 ? regret_sum[a] : 0;
-            sum += strategy[a];
-        }
-
-        for (int a = 0; a < NUM_ACTIONS; a++) {
-            if (sum > 0)
-                strategy[a] /= sum;
-            else
-                strategy[a] = 1.0 / NUM_ACTIONS;
-
-            strategy_sum[a] += realization_weight * strategy[a];
-        }
-
-        return strategy;
-    }
+#include "section-3-5-2.h"
 
-    vector<double> get_average_strategy(const vector<double>& strategy_sum) {
-        vector<double> avg(NUM_ACTIONS, 0.0);
-        double sum = accumulate(strategy_sum.begin(), strategy_sum.end(), 0.0);
-
-        for (int a = 0; a < NUM_ACTIONS; a++) {
-            avg[a] = (sum > 0) ? strategy_sum[a] / sum : 1.0 / NUM_ACTIONS;
-        }
-
-        return avg;
-    }
-};
-
-class DudoTrainer {
-   private:
-    mt19937 generator{0};
-    unordered_map<int, unique_ptr<Node>> node_map = unordered_map<int, unique_ptr<Node>>();
-
-    int get_infoset_key(int player_roll, const vector<int>& history) {
-        int infoset_num = player_roll;
+using namespace std;
+using history_dudo::DudoTrainer;
 
-        for (int a = NUM_ACTIONS - 2; a >= 0; a--) {
-            bool is_claimed = false;
-            for (int action : history) {
-                if (action == a) {
-                    is_claimed = true;
-                    break;
-                }
-            }
+void benchmark() {
+    cout << setw(6) << "Sides" << setw(6) << "Dice" << setw(12) << "Infosets" << setw(12) << "Iterations" << setw(12)
+         << "ns/visit" << endl;
 
-            infoset_num = 2 * infoset_num + (is_claimed ? 1 : 0);
-        }
+    const vector<pair<int, int>> configurations = {{2, 1}, {3, 1}, {4, 1}, {5, 1}, {6, 1}, {2, 2}, {3, 2}, {4, 2}};
 
-        return infoset_num;
-    }
+    for (auto [num_sides, dice_per_player] : configurations) {
+        if (!DudoTrainer::check_game(num_sides, dice_per_player)) continue;
 
-    int count_matches(const vector<int>& dice, int rank) {
-        int count = 0;
+        DudoTrainer solver = DudoTrainer(num_sides, dice_per_player);
+        int total_iterations = 0;
+        double elapsed = 0;
+        auto start = chrono::steady_clock::now();
 
-        for (int d : dice) {
-            if (d == rank || d == 1) count++;
+        for (int iterations = 1; elapsed < 1.0; iterations *= 2) {
+            solver.train(iterations);
+            total_iterations += iterations;
+            elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
         }
 
-        return count;
-    }
-
-    void roll(vector<int>& dice) {
-        uniform_int_distribution<> dist(1, 6);
-
-        for (int& die : dice) {
-            die = dist(generator);
-        }
+        cout << setw(6) << num_sides << setw(6) << dice_per_player << setw(12) << solver.get_num_infosets() << setw(12)
+             << total_iterations << setw(12) << fixed << setprecision(1) << elapsed * 1e9 / solver.get_node_visits()
+             << endl;
     }
+}
 
-    double cfr(vector<int> dice, vector<int>& history, double p0, double p1) {
-        int turn = history.size();
-        int player = turn % 2;
-
-        if (!history.empty() && history.back() == DUDO) {
-            int challenged_action = history[history.size() - 2];
-
-            int claim_num = CLAIM_NUM[challenged_action];
-            int claim_rank = CLAIM_RANK[challenged_action];
-            int count = count_matches(dice, claim_rank);
-
-            bool claimant_wins = (count >= claim_num);
-            int claimant = (turn - 2) % 2;
-
-            if (claimant_wins)
-                return (claimant == 0) ? 1.0 : -1.0;
-            else
-                return (claimant == 0) ? -1.0 : 1.0;
-        }
-
-        int key = get_infoset_key(dice[player], history);
-        auto& node = node_map.try_emplace(key, make_unique<Node>()).first->second;
-        node->id = key;
-
-        vector<double> strategy = node->get_strategy(player == 0 ? p0 : p1);
-        vector<double> utility = vector<double>(NUM_ACTIONS);
-        double node_utility = 0;
-
-        int last_action = history.empty() ? -1 : history.back();
-
-        for (int a = 0; a < NUM_ACTIONS; a++) {
-            if (a == DUDO && history.empty()) continue;
-            if (a != DUDO && !history.empty() && a <= last_action) continue;
-
-            history.push_back(a);
-            utility[a] = cfr(dice, history, player == 0 ? p0 * strategy[a] : p0, player == 1 ? p1 * strategy[a] : p1);
-            history.pop_back();
-
-            node_utility += strategy[a] * utility[a];
-        }
-
-        for (int a = 0; a < NUM_ACTIONS; a++) {
-            if (a == DUDO && history.empty()) continue;
-            if (a != DUDO && !history.empty() && a <= last_action) continue;
-
-            double regret;
-            if (player == 0) {
-                regret = utility[a] - node_utility;
-                node->regret_sum[a] += p1 * regret;
-            } else {
-                regret = node_utility - utility[a];
-                node->regret_sum[a] += p0 * regret;
-            }
-        }
-
-        return node_utility;
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "--benchmark") {
+        benchmark();
+        return 0;
     }
 
-   public:
-    void train(int iterations) {
-        vector<int> dice{0, 0};
-        vector<int> history;
-        double total_utility = 0;
+    int num_sides = argc > 1 ? stoi(argv[1]) : 6;
+    int dice_per_player = argc > 2 ? stoi(argv[2]) : 1;
+    if (!DudoTrainer::check_game(num_sides, dice_per_player)) return 1;
 
-        for (int i = 0; i < iterations; i++) {
-            roll(dice);
-            total_utility += cfr(dice, history, 1.0, 1.0);
-        }
-
-        cout << "Average game value: " << total_utility / iterations << endl;
-    }
-};
+    DudoTrainer solver = DudoTrainer(num_sides, dice_per_player);
+    if (argc > 4 && string(argv[4]) == "--resume" && !solver.load_checkpoint(argv[3])) return 1;
+    if (argc > 3) solver.enable_checkpoints(argv[3], 0, 600);
 
-int main() {
-    DudoTrainer solver = DudoTrainer();
-    solver.train(100'000);
+    int iterations = 100'000 - solver.get_completed_iterations();
+    if (iterations > 0) cout << "Average game value: " << solver.train(iterations) << endl;
 
     return 0;
 }
@@ -0,0 +1,235 @@
+// Section 3.5 (2) trainer: chance-sampled CFR for the last round of Dudo with full history vector passing. Used by
+// section-3-5-2.cpp and, as the reference, by dudo-equivalence.cpp.
+
+#ifndef SRC_SECTION_3_5_2_H_
+#define SRC_SECTION_3_5_2_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "checkpointer.h"
+#include "dudo.h"
+#include "philox.h"
+
+namespace history_dudo {
+
+using namespace std;
+
+class Node {
+   public:
+    int id;
+    int index = 0, checkpoint_epoch = 0;
+    int num_actions;
+    vector<double> regret_sum, strategy, strategy_sum;
+
+    Node(int num_actions)
+        : num_actions(num_actions),
+          regret_sum(num_actions, 0.0),
+          strategy(num_actions, 0.0),
+          strategy_sum(num_actions, 0.0) {}
+
+    vector<double> get_strategy(double realization_weight) {
+        double sum = 0.0;
+
+        for (int a = 0; a < num_actions; a++) {
+            strategy[a] = regret_sum[a] > 0 ? regret_sum[a] : 0;
+            sum += strategy[a];
+        }
+
+        for (int a = 0; a < num_actions; a++) {
+            if (sum > 0)
+                strategy[a] /= sum;
+            else
+                strategy[a] = 1.0 / num_actions;
+
+            if (realization_weight > 0) strategy_sum[a] += realization_weight * strategy[a];
+        }
+
+        return strategy;
+    }
+
+    vector<double> get_average_strategy(const vector<double>& strategy_sum) {
+        vector<double> avg(num_actions, 0.0);
+        double sum = accumulate(strategy_sum.begin(), strategy_sum.end(), 0.0);
+
+        for (int a = 0; a < num_actions; a++) {
+            avg[a] = (sum > 0) ? strategy_sum[a] / sum : 1.0 / num_actions;
+        }
+
+        return avg;
+    }
+};
+
+class DudoTrainer : private DudoGame {
+   private:
+    Philox generator{0};
+    unordered_map<int, unique_ptr<Node>> node_map = unordered_map<int, unique_ptr<Node>>();
+    int completed_iterations = 0;
+    long long node_visits = 0;
+    vector<Node*> nodes;
+
+    unique_ptr<Checkpointer<int>> checkpointer;
+
+    int get_infoset_key(int player_roll, const vector<int>& history) {
+        int infoset_num = player_roll;
+
+        for (int a = num_actions - 2; a >= 0; a--) {
+            bool is_claimed = false;
+            for (int action : history) {
+                if (action == a) {
+                    is_claimed = true;
+                    break;
+                }
+            }
+
+            infoset_num = 2 * infoset_num + (is_claimed ? 1 : 0);
+        }
+
+        return infoset_num;
+    }
+
+    Node* get_node(int key) {
+        auto [it, inserted] = node_map.try_emplace(key, nullptr);
+
+        if (inserted) {
+            it->second = make_unique<Node>(num_actions);
+            it->second->id = key;
+            it->second->index = nodes.size();
+            nodes.push_back(it->second.get());
+        }
+
+        return it->second.get();
+    }
+
+    double cfr(vector<int> dice, vector<int>& history, double p0, double p1, int traverser) {
+        int turn = history.size();
+        int player = turn % 2;
+
+        if (!history.empty() && history.back() == dudo) {
+            return get_challenge_utility(dice, history[history.size() - 2], (turn - 2) % 2);
+        }
+
+        bool alternating = traverser >= 0;
+        if (alternating && (traverser == 0 ? p1 : p0) == 0) return 0;
+
+        int key = get_infoset_key(get_roll_code(dice, player), history);
+        Node* node = get_node(key);
+        if (checkpointer) checkpointer->preserve(node, &Node::id);
+        node_visits++;
+
+        double realization_weight = alternating && player == traverser ? 0.0 : (player == 0 ? p0 : p1);
+        vector<double> strategy = node->get_strategy(realization_weight);
+        vector<double> utility = vector<double>(num_actions);
+        double node_utility = 0;
+
+        int last_action = history.empty() ? -1 : history.back();
+
+        for (int a = 0; a < num_actions; a++) {
+            if (a == dudo && history.empty()) continue;
+            if (a != dudo && !history.empty() && a <= last_action) continue;
+
+            history.push_back(a);
+            utility[a] = cfr(dice, history, player == 0 ? p0 * strategy[a] : p0, player == 1 ? p1 * strategy[a] : p1,
+                             traverser);
+            history.pop_back();
+
+            node_utility += strategy[a] * utility[a];
+        }
+
+        if (alternating && player != traverser) return node_utility;
+
+        for (int a = 0; a < num_actions; a++) {
+            if (a == dudo && history.empty()) continue;
+            if (a != dudo && !history.empty() && a <= last_action) continue;
+
+            double regret;
+            if (player == 0) {
+                regret = utility[a] - node_utility;
+                node->regret_sum[a] += p1 * regret;
+            } else {
+                regret = node_utility - utility[a];
+                node->regret_sum[a] += p0 * regret;
+            }
+        }
+
+        return node_utility;
+    }
+
+   public:
+    using DudoGame::check_game;
+
+    DudoTrainer(int num_sides = 6, int dice_per_player = 1) : DudoGame(num_sides, dice_per_player) {}
+
+    void enable_checkpoints(const string& filename, int every_iterations, double every_seconds) {
+        checkpointer = make_unique<Checkpointer<int>>(filename, num_actions, every_iterations, every_seconds,
+                                                      completed_iterations);
+    }
+
+    bool load_checkpoint(const string& filename) {
+        Checkpointer<int>::Snapshot saved;
+        if (!Checkpointer<int>::read(filename, num_actions, saved)) return false;
+
+        node_map.clear();
+        nodes.clear();
+        for (size_t k = 0; k < saved.keys.size(); k++) {
+            Node* node = get_node(saved.keys[k]);
+
+            const double* values = &saved.values[k * 2 * num_actions];
+            copy(values, values + num_actions, node->regret_sum.begin());
+            copy(values + num_actions, values + 2 * num_actions, node->strategy_sum.begin());
+        }
+
+        completed_iterations = saved.iteration;
+        return true;
+    }
+
+    double train(int iterations, bool alternating = false) {
+        vector<int> dice(2 * dice_per_player, 0);
+        vector<int> history;
+        double total_utility = 0;
+
+        for (int i = completed_iterations; i < completed_iterations + iterations; i++) {
+            roll(generator, dice, i);
+            total_utility += cfr(dice, history, 1.0, 1.0, alternating ? i % 2 : -1);
+
+            if (checkpointer) checkpointer->advance(i + 1, nodes, &Node::id);
+        }
+
+        completed_iterations += iterations;
+        if (checkpointer) checkpointer->take_final(completed_iterations, nodes, &Node::id);
+
+        return total_utility / iterations;
+    }
+
+    size_t get_num_infosets() const { return node_map.size(); }
+
+    long long get_node_visits() const { return node_visits; }
+
+    int get_completed_iterations() const { return completed_iterations; }
+
+    // Keys of every infoset reached so far, in increasing order.
+    vector<int> get_infoset_keys() const {
+        vector<int> keys;
+        keys.reserve(node_map.size());
+        for (const auto& pair : node_map) keys.push_back(pair.first);
+        sort(keys.begin(), keys.end());
+        return keys;
+    }
+
+    // The average strategy at the infoset with the given key, or an empty vector if training never reached it.
+    vector<double> get_average_strategy(int key) const {
+        auto it = node_map.find(key);
+        if (it == node_map.end()) return {};
+        return it->second->get_average_strategy(it->second->strategy_sum);
+    }
+};
+
+}  // namespace history_dudo
+
+#endif  // SRC_SECTION_3_5_2_H_